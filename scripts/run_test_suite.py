@@ -3,8 +3,12 @@
 Run all Game Boy test ROMs under input/test_roms and report PASS/FAIL/TIMEOUT.
 
 A test is considered PASS when its output contains the pass pattern
-(default: "passed", case-insensitive). If the pattern appears, the test process
-is terminated and the runner moves to the next test.
+(default: "passed", case-insensitive). The emulator watches its serial output
+for the pass and fail patterns itself (--until-serial / --fail-serial) and exits
+as soon as one appears (with --no-stop-on-pass only on the fail pattern);
+--frames/--cycles give it a deterministic budget too.
+The wall-clock timeout remains as a safety net for ROMs that report only on
+screen.
 """
 
 from __future__ import annotations
@@ -22,6 +26,11 @@ import threading
 import time
 
 
+# bin/easygb exit codes for runs with --until-serial (see enum run_exit).
+EXIT_FAIL_SERIAL = 2
+EXIT_LIMIT_REACHED = 3
+
+
 @dataclass
 class TestResult:
     rom: Path
@@ -73,10 +82,17 @@ def run_single_test(
     stop_on_pass: bool,
     quiet: bool,
     log_path: Path,
+    limit_args: list[str],
 ) -> TestResult:
     start = time.monotonic()
+    cmd = [str(binary), *limit_args]
+    if stop_on_pass:
+        cmd += ["--until-serial", pass_pattern]
+    if fail_pattern:
+        cmd += ["--fail-serial", fail_pattern]
+    cmd.append(str(rom))
     proc = subprocess.Popen(
-        [str(binary), str(rom)],
+        cmd,
         stdout=subprocess.PIPE,
         stderr=subprocess.STDOUT,
     )
@@ -162,9 +178,12 @@ def run_single_test(
     elif timeout_hit:
         status = "TIMEOUT"
         reason = f"no '{pass_pattern}' within {timeout_s:.1f}s"
-    elif fail_seen:
+    elif fail_seen or rc == EXIT_FAIL_SERIAL:
         status = "FAIL"
         reason = f"matched '{fail_pattern}' without '{pass_pattern}'"
+    elif rc == EXIT_LIMIT_REACHED:
+        status = "TIMEOUT"
+        reason = f"no '{pass_pattern}' within the frame/cycle budget"
     elif rc not in (0, None):
         status = "ERROR"
         reason = f"exit code {rc} without '{pass_pattern}'"
@@ -196,12 +215,14 @@ def main() -> int:
     parser.add_argument("--bin", default="bin/easygb", help="Path to emulator binary (default: bin/easygb)")
     parser.add_argument("--tests-root", default="input/test_roms", help="Folder containing test ROMs")
     parser.add_argument("--timeout", type=float, default=20.0, help="Timeout per test in seconds")
+    parser.add_argument("--frames", type=int, default=0, help="Emulated frame budget per test (0: none)")
+    parser.add_argument("--cycles", type=int, default=0, help="Emulated cycle budget per test (0: none)")
     parser.add_argument("--pass-pattern", default="passed", help="Case-insensitive pass token")
     parser.add_argument("--fail-pattern", default="failed", help="Case-insensitive fail token")
     parser.add_argument(
         "--no-stop-on-pass",
         action="store_true",
-        help="Do not terminate process immediately after matching pass token",
+        help="Keep running after the pass token (until the fail token, the frame/cycle budget or the timeout)",
     )
     parser.add_argument("--stop-on-first-nonpass", action="store_true", help="Stop suite on first non-PASS result")
     parser.add_argument("--quiet", action="store_true", help="Do not stream test output live")
@@ -249,6 +270,11 @@ def main() -> int:
     results: list[TestResult] = []
     total = len(roms)
     stop_on_pass = not args.no_stop_on_pass
+    limit_args: list[str] = []
+    if args.frames > 0:
+        limit_args += ["--frames", str(args.frames)]
+    if args.cycles > 0:
+        limit_args += ["--cycles", str(args.cycles)]
 
     try:
         for idx, rom in enumerate(roms, start=1):
@@ -266,6 +292,7 @@ def main() -> int:
                 stop_on_pass=stop_on_pass,
                 quiet=args.quiet,
                 log_path=log_path,
+                limit_args=limit_args,
             )
             results.append(result)
             print(
@@ -1,21 +1,34 @@
 #include "include/apu.h"
+#include "include/apu_log.h"
+#include "include/apu_mix.h"
+#include "include/blip.h"
 #include "include/debug.h"
+#include "include/prof.h"
 
-#ifdef EASYGB_USE_SDL
-#include <SDL2/SDL.h>
-#endif
+#include "include/spsc_ring.h"
 
+#include <pthread.h>
+#include <sched.h>
 #include <stdlib.h>
 #include <string.h>
 
 enum {
     GB_CPU_HZ = 4194304,
-    APU_SAMPLE_RATE = 48000,
+    APU_SAMPLE_RATE = 48000,    // default; EASYGB_AUDIO_RATE picks 22050-96000
+    APU_MIN_SAMPLE_RATE = 22050,
+    APU_MAX_SAMPLE_RATE = 96000,
     APU_BATCH_SAMPLES = 512,
-    FRAME_SEQ_PERIOD = 8192
+    FRAME_SEQ_PERIOD = 8192,
+    APU_MAX_BLOCK_CYCLES = GB_CPU_HZ / 32, // fits BLIP_CAPACITY up to 96 kHz
+    APU_CHANNELS = 4,
+    APU_REG_BASE = 0xFF10,
+    APU_REG_COUNT = 0x30,       // FF10-FF3F: NR10-NR52 and wave RAM
+    NR52_INDEX = 0x16,
+    WAVE_RAM_INDEX = 0x20,
+    APU_LOG_CAPACITY = 16384,   // entries; several frames of heavy register traffic
+    APU_LOG_BATCH = 64
 };
 
-#ifdef EASYGB_USE_SDL
 typedef struct {
     uint8_t nrx0;
     uint8_t nrx1;
@@ -83,37 +96,65 @@ typedef struct {
     uint16_t lfsr;
     uint32_t timer;
 } noise_channel;
-#endif
+
+struct apu_worker;
 
 struct APU {
     bus mbus;
+    apu_sink sink;
+    bool synth;                 // run channel timers and mix into sink
+
+    // Set on the emulation thread's APU when a worker synthesizes the
+    // audio: this one then only keeps register semantics (NR52) current.
+    struct apu_worker *worker;
+    apu_log_file capture;       // EASYGB_APU_LOG
 
-#ifdef EASYGB_USE_SDL
+    // FF10-FF3F as last written; reads apply apu_read_masks, and NR52 is
+    // assembled from master_on and the channel status.
+    uint8_t regs[APU_REG_COUNT];
     bool master_on;
 
-    uint64_t sample_accum;
+    // Channels and the frame sequencer run lazily: time catches up with the
+    // bus clock on sound register access and at apu_end_frame.
+    uint64_t time;
+    uint64_t block_start;       // clock of the blip buffers' current frame
     uint32_t frame_seq_counter;
     uint8_t frame_seq_step;
-    uint32_t io_seen[0x80];
 
     square_channel ch1;
     square_channel ch2;
     wave_channel ch3;
     noise_channel ch4;
 
-    float hp_l_prev_in;
-    float hp_r_prev_in;
-    float hp_l_prev_out;
-    float hp_r_prev_out;
+    // Output rate trim for audio-clock pacing; applied at the next block
+    // boundary so a block never mixes two rates.
+    double rate_adjust;
+    bool rate_pending;
+
+    // Each channel's output level as last reported to its step buffer.
+    blip_buffer blip[APU_CHANNELS];
+    int amp[APU_CHANNELS];
+    int32_t chan_block[APU_CHANNELS][APU_BATCH_SAMPLES];
+
+    // NR50/NR51 as mixer gains, rebuilt on write.
+    struct apu_mix_gains gains;
+    struct apu_hpf hpf;
 
-    SDL_AudioDeviceID dev;
-    bool audio_ready;
-    float mixbuf[APU_BATCH_SAMPLES * 2];
+    int16_t mixbuf[APU_BATCH_SAMPLES * 2];
     int mix_count;
-#endif
 };
 
-#ifdef EASYGB_USE_SDL
+// Bits that always read back as 1 (DMG), indexed from FF10.
+static const uint8_t apu_read_masks[APU_REG_COUNT] = {
+    0x80, 0x3F, 0x00, 0xFF, 0xBF,   // NR10-NR14
+    0xFF, 0x3F, 0x00, 0xFF, 0xBF,   // FF15, NR21-NR24
+    0x7F, 0xFF, 0x9F, 0xFF, 0xBF,   // NR30-NR34
+    0xFF, 0xFF, 0x00, 0x00, 0xBF,   // FF1F, NR41-NR44
+    0x00, 0x00, 0x70,               // NR50-NR52
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,   // FF27-FF2F
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,         // wave RAM
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
 
 static const uint8_t square_duty_table[4][8] = {
     {0, 0, 0, 0, 0, 0, 0, 1},
@@ -122,12 +163,6 @@ static const uint8_t square_duty_table[4][8] = {
     {0, 1, 1, 1, 1, 1, 1, 0}
 };
 
-static inline float clampf(float v, float lo, float hi) {
-    if (v < lo) return lo;
-    if (v > hi) return hi;
-    return v;
-}
-
 static inline uint32_t square_period_cycles(uint16_t freq) {
     uint16_t f = (uint16_t)(freq & 0x07FFu);
     if (f >= 2048u) {
@@ -371,216 +406,289 @@ static void square_clock_sweep(square_channel *ch) {
     }
 }
 
-static void square_step_timer(square_channel *ch, int cycles) {
-    if (!ch->enabled || cycles <= 0) {
+// Output levels are in 1/15 steps of full scale: -15..15 per channel.
+static int square_amp(const square_channel *ch) {
+    if (!ch->enabled || !ch->dac_enabled) {
+        return 0;
+    }
+
+    uint8_t duty = (uint8_t)((ch->nrx1 >> 6) & 0x03u);
+    return square_duty_table[duty][ch->duty_step] != 0u ? (int)ch->volume : -(int)ch->volume;
+}
+
+static int wave_amp(const struct APU *a) {
+    uint8_t level_code = (uint8_t)((a->ch3.nr32 >> 5) & 0x03u);
+    if (!a->ch3.enabled || !a->ch3.dac_enabled || level_code == 0u) {
+        return 0;
+    }
+
+    uint8_t pos = (uint8_t)(a->ch3.pos & 0x1Fu);
+    uint8_t wave_byte = a->regs[WAVE_RAM_INDEX + (pos >> 1)];
+    uint8_t sample4 = (pos & 1u) == 0u ? (uint8_t)(wave_byte >> 4) : (uint8_t)(wave_byte & 0x0Fu);
+    return ((int)sample4 * 2 - 15) >> (level_code - 1u);
+}
+
+static int noise_amp(const noise_channel *ch) {
+    if (!ch->enabled || !ch->dac_enabled) {
+        return 0;
+    }
+    return (ch->lfsr & 0x01u) == 0u ? (int)ch->volume : -(int)ch->volume;
+}
+
+static inline void set_amp(apu a, int c, uint32_t t, int amp) {
+    if (amp != a->amp[c]) {
+        blip_add_delta(a->blip[c], t, amp - a->amp[c]);
+        a->amp[c] = amp;
+    }
+}
+
+static inline uint32_t block_time(const struct APU *a) {
+    return (uint32_t)(a->time - a->block_start);
+}
+
+// Reports level changes caused by anything but the channel timers.
+static void apu_update_amps(apu a) {
+    if (!a->synth) {
         return;
     }
 
+    uint32_t t = block_time(a);
+    set_amp(a, 0, t, square_amp(&a->ch1));
+    set_amp(a, 1, t, square_amp(&a->ch2));
+    set_amp(a, 2, t, wave_amp(a));
+    set_amp(a, 3, t, noise_amp(&a->ch4));
+}
+
+// Advances a timer that fires every period cycles over span cycles and
+// returns how many times it fired, for channels whose level cannot change.
+static inline uint32_t skip_timer(uint32_t *timer, uint32_t period, uint32_t span) {
+    if (span < *timer) {
+        *timer -= span;
+        return 0u;
+    }
+
+    span -= *timer;
+    *timer = period - span % period;
+    return 1u + span / period;
+}
+
+// The channel runners walk timer edges between t and end (block time) and
+// only touch the step buffer where the output level changes.
+static void square_run(apu a, int c, square_channel *ch, uint32_t t, uint32_t end) {
+    if (!ch->enabled) {
+        return;
+    }
+
+    uint32_t period = square_period_cycles(ch->freq);
     if (ch->timer == 0u) {
-        ch->timer = square_period_cycles(ch->freq);
+        ch->timer = period;
     }
 
-    while (cycles > 0) {
-        uint32_t step = (uint32_t)cycles;
-        if (step < ch->timer) {
-            ch->timer -= step;
-            break;
-        }
+    if (ch->volume == 0u) {
+        uint32_t steps = skip_timer(&ch->timer, period, end - t);
+        ch->duty_step = (uint8_t)((ch->duty_step + steps) & 0x07u);
+        return;
+    }
 
-        cycles -= (int)ch->timer;
-        ch->timer = square_period_cycles(ch->freq);
+    while (end - t >= ch->timer) {
+        t += ch->timer;
+        ch->timer = period;
         ch->duty_step = (uint8_t)((ch->duty_step + 1u) & 0x07u);
+        set_amp(a, c, t, square_amp(ch));
     }
+    ch->timer -= end - t;
 }
 
-static void wave_step_timer(wave_channel *ch, int cycles) {
-    if (!ch->enabled || !ch->dac_enabled || cycles <= 0) {
+static void wave_run(apu a, uint32_t t, uint32_t end) {
+    wave_channel *ch = &a->ch3;
+    if (!ch->enabled || !ch->dac_enabled) {
         return;
     }
 
+    uint32_t period = wave_period_cycles(ch->freq);
     if (ch->timer == 0u) {
-        ch->timer = wave_period_cycles(ch->freq);
+        ch->timer = period;
     }
 
-    while (cycles > 0) {
-        uint32_t step = (uint32_t)cycles;
-        if (step < ch->timer) {
-            ch->timer -= step;
-            break;
-        }
+    if ((ch->nr32 & 0x60u) == 0u) {
+        uint32_t steps = skip_timer(&ch->timer, period, end - t);
+        ch->pos = (uint8_t)((ch->pos + steps) & 0x1Fu);
+        return;
+    }
 
-        cycles -= (int)ch->timer;
-        ch->timer = wave_period_cycles(ch->freq);
+    while (end - t >= ch->timer) {
+        t += ch->timer;
+        ch->timer = period;
         ch->pos = (uint8_t)((ch->pos + 1u) & 0x1Fu);
+        set_amp(a, 2, t, wave_amp(a));
     }
+    ch->timer -= end - t;
 }
 
-static void noise_step_timer(noise_channel *ch, int cycles) {
-    if (!ch->enabled || !ch->dac_enabled || cycles <= 0) {
+static void noise_run(apu a, uint32_t t, uint32_t end) {
+    noise_channel *ch = &a->ch4;
+    if (!ch->enabled || !ch->dac_enabled) {
         return;
     }
 
+    uint32_t period = noise_period_cycles(ch->nr43);
     if (ch->timer == 0u) {
-        ch->timer = noise_period_cycles(ch->nr43);
+        ch->timer = period;
     }
 
-    while (cycles > 0) {
-        uint32_t step = (uint32_t)cycles;
-        if (step < ch->timer) {
-            ch->timer -= step;
-            break;
-        }
-
-        cycles -= (int)ch->timer;
-        ch->timer = noise_period_cycles(ch->nr43);
+    while (end - t >= ch->timer) {
+        t += ch->timer;
+        ch->timer = period;
 
-        {
-            uint16_t feedback = (uint16_t)((ch->lfsr ^ (ch->lfsr >> 1)) & 0x01u);
-            ch->lfsr = (uint16_t)((ch->lfsr >> 1) | (feedback << 14));
-            if ((ch->nr43 & 0x08u) != 0u) {
-                ch->lfsr = (uint16_t)((ch->lfsr & ~(1u << 6)) | (feedback << 6));
-            }
+        uint16_t feedback = (uint16_t)((ch->lfsr ^ (ch->lfsr >> 1)) & 0x01u);
+        ch->lfsr = (uint16_t)((ch->lfsr >> 1) | (feedback << 14));
+        if ((ch->nr43 & 0x08u) != 0u) {
+            ch->lfsr = (uint16_t)((ch->lfsr & ~(1u << 6)) | (feedback << 6));
         }
+        set_amp(a, 3, t, noise_amp(ch));
     }
+    ch->timer -= end - t;
 }
 
-static void apu_frame_step(apu a, int cycles) {
-    if (cycles <= 0) {
-        return;
-    }
+static void apu_clock_frame_seq(apu a) {
+    a->frame_seq_step = (uint8_t)((a->frame_seq_step + 1u) & 0x07u);
 
-    a->frame_seq_counter += (uint32_t)cycles;
+    if ((a->frame_seq_step & 1u) == 0u) {
+        square_clock_length(&a->ch1);
+        square_clock_length(&a->ch2);
+        wave_clock_length(&a->ch3);
+        noise_clock_length(&a->ch4);
+    }
 
-    while (a->frame_seq_counter >= FRAME_SEQ_PERIOD) {
-        a->frame_seq_counter -= FRAME_SEQ_PERIOD;
-        a->frame_seq_step = (uint8_t)((a->frame_seq_step + 1u) & 0x07u);
+    if (a->frame_seq_step == 2u || a->frame_seq_step == 6u) {
+        square_clock_sweep(&a->ch1);
+    }
 
-        if ((a->frame_seq_step & 1u) == 0u) {
-            square_clock_length(&a->ch1);
-            square_clock_length(&a->ch2);
-            wave_clock_length(&a->ch3);
-            noise_clock_length(&a->ch4);
-        }
+    if (a->frame_seq_step == 7u) {
+        square_clock_envelope(&a->ch1);
+        square_clock_envelope(&a->ch2);
+        noise_clock_envelope(&a->ch4);
+    }
+}
 
-        if (a->frame_seq_step == 2u || a->frame_seq_step == 6u) {
-            square_clock_sweep(&a->ch1);
+// Runs the channels and frame sequencer to target within one block,
+// splitting the span at frame sequencer edges.
+static void apu_run_span(apu a, uint64_t target, bool synth) {
+    while (a->time < target) {
+        uint64_t seq_edge = a->time + (FRAME_SEQ_PERIOD - a->frame_seq_counter);
+        uint64_t end = target < seq_edge ? target : seq_edge;
+
+        if (synth) {
+            uint32_t t0 = block_time(a);
+            uint32_t t1 = (uint32_t)(end - a->block_start);
+            square_run(a, 0, &a->ch1, t0, t1);
+            square_run(a, 1, &a->ch2, t0, t1);
+            wave_run(a, t0, t1);
+            noise_run(a, t0, t1);
         }
 
-        if (a->frame_seq_step == 7u) {
-            square_clock_envelope(&a->ch1);
-            square_clock_envelope(&a->ch2);
-            noise_clock_envelope(&a->ch4);
+        a->frame_seq_counter += (uint32_t)(end - a->time);
+        a->time = end;
+        if (a->frame_seq_counter >= FRAME_SEQ_PERIOD) {
+            a->frame_seq_counter -= FRAME_SEQ_PERIOD;
+            apu_clock_frame_seq(a);
+            apu_update_amps(a);
         }
     }
 }
 
-static float square_output(const square_channel *ch) {
-    if (!ch->enabled || !ch->dac_enabled || ch->volume == 0u) {
-        return 0.0f;
-    }
-
-    {
-        uint8_t duty = (uint8_t)((ch->nrx1 >> 6) & 0x03u);
-        uint8_t out = square_duty_table[duty][ch->duty_step];
-        float amp = out != 0u ? 1.0f : -1.0f;
-        float vol = (float)ch->volume / 15.0f;
-        return amp * vol;
+static void apu_flush_samples(apu a) {
+    if (a->mix_count > 0) {
+        apu_sink_write(a->sink, a->mixbuf, (size_t)a->mix_count);
+        a->mix_count = 0;
     }
 }
 
-static float wave_output(apu a) {
-    if (!a->ch3.enabled || !a->ch3.dac_enabled) {
-        return 0.0f;
-    }
+// Mixes count samples of chan_block into the sink batch.
+static void apu_mix_samples(apu a, int count) {
+    int done = 0;
 
-    {
-        uint8_t level_code = (uint8_t)((a->ch3.nr32 >> 5) & 0x03u);
-        float level_mul = 0.0f;
-        if (level_code == 1u) level_mul = 1.0f;
-        else if (level_code == 2u) level_mul = 0.5f;
-        else if (level_code == 3u) level_mul = 0.25f;
-
-        if (level_mul == 0.0f) {
-            return 0.0f;
+    while (done < count) {
+        int n = count - done;
+        if (n > APU_BATCH_SAMPLES - a->mix_count) {
+            n = APU_BATCH_SAMPLES - a->mix_count;
         }
 
-        uint8_t pos = (uint8_t)(a->ch3.pos & 0x1Fu);
-        uint8_t wave_byte = bus_read8(a->mbus, (uint16_t)(0xFF30u + (pos >> 1)));
-        uint8_t sample4 = (pos & 1u) == 0u ? (uint8_t)(wave_byte >> 4) : (uint8_t)(wave_byte & 0x0Fu);
+        int16_t *out = &a->mixbuf[a->mix_count * 2];
+        if (a->master_on) {
+            const int32_t *chan[APU_CHANNELS] = {
+                &a->chan_block[0][done], &a->chan_block[1][done],
+                &a->chan_block[2][done], &a->chan_block[3][done]
+            };
+            apu_mix_block(&a->gains, &a->hpf, chan, out, n);
+        } else {
+            memset(out, 0, (size_t)n * 2u * sizeof(out[0]));
+        }
 
-        {
-            float base = ((float)sample4 / 15.0f) * 2.0f - 1.0f;
-            return base * level_mul;
+        a->mix_count += n;
+        done += n;
+        if (a->mix_count >= APU_BATCH_SAMPLES) {
+            apu_flush_samples(a);
         }
     }
 }
 
-static float noise_output(const noise_channel *ch) {
-    if (!ch->enabled || !ch->dac_enabled || ch->volume == 0u) {
-        return 0.0f;
+// Closes the current step-buffer frame at time and mixes every sample it
+// completed, with the NR50/NR51/NR52 state in effect up to that point.
+static void apu_render(apu a) {
+    if (!a->synth) {
+        a->block_start = a->time;
+        return;
     }
 
-    {
-        float amp = (ch->lfsr & 0x01u) == 0u ? 1.0f : -1.0f;
-        float vol = (float)ch->volume / 15.0f;
-        return amp * vol;
+    uint32_t clocks = block_time(a);
+    for (int c = 0; c < APU_CHANNELS; c++) {
+        blip_end_frame(a->blip[c], clocks);
+        if (a->rate_pending) {
+            blip_set_rates(a->blip[c], GB_CPU_HZ, a->sink->sample_rate * a->rate_adjust);
+        }
+    }
+    a->rate_pending = false;
+    a->block_start = a->time;
+
+    int avail = a->blip[0]->avail;
+    while (avail > 0) {
+        int n = avail < APU_BATCH_SAMPLES ? avail : APU_BATCH_SAMPLES;
+        for (int c = 0; c < APU_CHANNELS; c++) {
+            blip_read_samples(a->blip[c], a->chan_block[c], n);
+        }
+        apu_mix_samples(a, n);
+        avail -= n;
     }
 }
 
-static void apu_mix_sample(apu a, float *left, float *right) {
-    if (!a->master_on) {
-        *left = 0.0f;
-        *right = 0.0f;
-        return;
-    }
+// Catches the APU up to target, rendering whenever a block fills up so
+// long stretches without register access still fit the step buffers.
+// Without synthesis only the frame sequencer runs.
+static void apu_run(apu a, uint64_t target) {
+    bool synth = a->synth;
 
-    {
-        uint8_t nr50 = bus_read8(a->mbus, 0xFF24);
-        uint8_t nr51 = bus_read8(a->mbus, 0xFF25);
-
-        float c1 = square_output(&a->ch1);
-        float c2 = square_output(&a->ch2);
-        float c3 = wave_output(a);
-        float c4 = noise_output(&a->ch4);
-
-        float l = 0.0f;
-        float r = 0.0f;
-
-        if ((nr51 & 0x10u) != 0u) l += c1;
-        if ((nr51 & 0x20u) != 0u) l += c2;
-        if ((nr51 & 0x40u) != 0u) l += c3;
-        if ((nr51 & 0x80u) != 0u) l += c4;
-
-        if ((nr51 & 0x01u) != 0u) r += c1;
-        if ((nr51 & 0x02u) != 0u) r += c2;
-        if ((nr51 & 0x04u) != 0u) r += c3;
-        if ((nr51 & 0x08u) != 0u) r += c4;
-
-        {
-            float lvol = (float)(((nr50 >> 4) & 0x07u) + 1u) / 8.0f;
-            float rvol = (float)((nr50 & 0x07u) + 1u) / 8.0f;
-            const float master_gain = 0.22f;
-            l *= lvol * master_gain;
-            r *= rvol * master_gain;
+    while (a->time < target) {
+        uint64_t end = a->block_start + APU_MAX_BLOCK_CYCLES;
+        if (target < end) {
+            end = target;
         }
 
-        {
-            const float hp_r = 0.996f;
-            float out_l = l - a->hp_l_prev_in + hp_r * a->hp_l_prev_out;
-            float out_r = r - a->hp_r_prev_in + hp_r * a->hp_r_prev_out;
-            a->hp_l_prev_in = l;
-            a->hp_r_prev_in = r;
-            a->hp_l_prev_out = out_l;
-            a->hp_r_prev_out = out_r;
-            l = out_l;
-            r = out_r;
+        if (!a->master_on) {
+            a->time = end;
+        } else {
+            apu_run_span(a, end, synth);
+        }
+        if (a->time - a->block_start >= APU_MAX_BLOCK_CYCLES) {
+            apu_render(a);
         }
-
-        *left = clampf(l, -1.0f, 1.0f);
-        *right = clampf(r, -1.0f, 1.0f);
     }
 }
 
+static inline void apu_sync(apu a) {
+    apu_run(a, bus_get_cycles(a->mbus));
+}
+
 static void apu_reset_runtime(apu a) {
     memset(&a->ch1, 0, sizeof(a->ch1));
     memset(&a->ch2, 0, sizeof(a->ch2));
@@ -594,68 +702,124 @@ static void apu_reset_runtime(apu a) {
     a->frame_seq_counter = 0u;
     a->frame_seq_step = 0u;
 
-    a->hp_l_prev_in = 0.0f;
-    a->hp_r_prev_in = 0.0f;
-    a->hp_l_prev_out = 0.0f;
-    a->hp_r_prev_out = 0.0f;
+    apu_hpf_init(&a->hpf, a->sink->sample_rate);
 }
 
-static void apu_sync_regs_from_bus(apu a) {
-    a->ch1.nrx0 = bus_read8(a->mbus, 0xFF10);
-    a->ch1.nrx1 = bus_read8(a->mbus, 0xFF11);
-    a->ch1.nrx2 = bus_read8(a->mbus, 0xFF12);
-    a->ch1.nrx3 = bus_read8(a->mbus, 0xFF13);
-    a->ch1.nrx4 = bus_read8(a->mbus, 0xFF14);
+static inline uint8_t reg(const struct APU *a, uint16_t addr) {
+    return a->regs[addr - APU_REG_BASE];
+}
+
+static inline void apu_refresh_gains(apu a) {
+    apu_mix_set_gains(&a->gains, reg(a, 0xFF24), reg(a, 0xFF25));
+}
+
+// Rebuilds channel state from the register file (power-on, init).
+static void apu_load_channel_regs(apu a) {
+    a->ch1.nrx0 = reg(a, 0xFF10);
+    a->ch1.nrx1 = reg(a, 0xFF11);
+    a->ch1.nrx2 = reg(a, 0xFF12);
+    a->ch1.nrx3 = reg(a, 0xFF13);
+    a->ch1.nrx4 = reg(a, 0xFF14);
     a->ch1.length_counter = (uint8_t)(64u - (a->ch1.nrx1 & 0x3Fu));
     a->ch1.length_enable = (a->ch1.nrx4 & 0x40u) != 0u;
     square_update_freq(&a->ch1);
     square_update_dac(&a->ch1);
 
-    a->ch2.nrx1 = bus_read8(a->mbus, 0xFF16);
-    a->ch2.nrx2 = bus_read8(a->mbus, 0xFF17);
-    a->ch2.nrx3 = bus_read8(a->mbus, 0xFF18);
-    a->ch2.nrx4 = bus_read8(a->mbus, 0xFF19);
+    a->ch2.nrx1 = reg(a, 0xFF16);
+    a->ch2.nrx2 = reg(a, 0xFF17);
+    a->ch2.nrx3 = reg(a, 0xFF18);
+    a->ch2.nrx4 = reg(a, 0xFF19);
     a->ch2.length_counter = (uint8_t)(64u - (a->ch2.nrx1 & 0x3Fu));
     a->ch2.length_enable = (a->ch2.nrx4 & 0x40u) != 0u;
     square_update_freq(&a->ch2);
     square_update_dac(&a->ch2);
 
-    a->ch3.nr30 = bus_read8(a->mbus, 0xFF1A);
-    a->ch3.nr31 = bus_read8(a->mbus, 0xFF1B);
-    a->ch3.nr32 = bus_read8(a->mbus, 0xFF1C);
-    a->ch3.nr33 = bus_read8(a->mbus, 0xFF1D);
-    a->ch3.nr34 = bus_read8(a->mbus, 0xFF1E);
+    a->ch3.nr30 = reg(a, 0xFF1A);
+    a->ch3.nr31 = reg(a, 0xFF1B);
+    a->ch3.nr32 = reg(a, 0xFF1C);
+    a->ch3.nr33 = reg(a, 0xFF1D);
+    a->ch3.nr34 = reg(a, 0xFF1E);
     a->ch3.length_counter = (uint16_t)(256u - a->ch3.nr31);
     a->ch3.length_enable = (a->ch3.nr34 & 0x40u) != 0u;
     wave_update_freq(&a->ch3);
     wave_update_dac(&a->ch3);
 
-    a->ch4.nr41 = bus_read8(a->mbus, 0xFF20);
-    a->ch4.nr42 = bus_read8(a->mbus, 0xFF21);
-    a->ch4.nr43 = bus_read8(a->mbus, 0xFF22);
-    a->ch4.nr44 = bus_read8(a->mbus, 0xFF23);
+    a->ch4.nr41 = reg(a, 0xFF20);
+    a->ch4.nr42 = reg(a, 0xFF21);
+    a->ch4.nr43 = reg(a, 0xFF22);
+    a->ch4.nr44 = reg(a, 0xFF23);
     a->ch4.length_counter = (uint8_t)(64u - (a->ch4.nr41 & 0x3Fu));
     a->ch4.length_enable = (a->ch4.nr44 & 0x40u) != 0u;
     noise_update_dac(&a->ch4);
 }
 
+// On DMG the length counters are not affected by APU power.
+struct length_counters {
+    uint8_t ch1;
+    uint8_t ch2;
+    uint16_t ch3;
+    uint8_t ch4;
+};
+
+static struct length_counters save_length_counters(const struct APU *a) {
+    struct length_counters l = {
+        a->ch1.length_counter, a->ch2.length_counter,
+        a->ch3.length_counter, a->ch4.length_counter
+    };
+    return l;
+}
+
+static void restore_length_counters(apu a, struct length_counters l) {
+    a->ch1.length_counter = l.ch1;
+    a->ch2.length_counter = l.ch2;
+    a->ch3.length_counter = l.ch3;
+    a->ch4.length_counter = l.ch4;
+}
+
 static void apu_power_on(apu a) {
+    struct length_counters lengths = save_length_counters(a);
     apu_reset_runtime(a);
     a->master_on = true;
-    apu_sync_regs_from_bus(a);
+    apu_load_channel_regs(a);
+    restore_length_counters(a, lengths);
 }
 
+// Powering off clears NR10-NR51; wave RAM survives.
 static void apu_power_off(apu a) {
+    struct length_counters lengths = save_length_counters(a);
     apu_reset_runtime(a);
     a->master_on = false;
+    memset(a->regs, 0, NR52_INDEX);
+    restore_length_counters(a, lengths);
+    apu_refresh_gains(a);
+}
 
-    if (a->audio_ready && a->dev != 0) {
-        SDL_ClearQueuedAudio(a->dev);
-        a->mix_count = 0;
+// While powered off the DMG still accepts wave RAM and the length counters.
+static void apu_write_while_off(apu a, uint16_t addr, uint8_t val) {
+    switch (addr) {
+    case 0xFF11:
+        a->ch1.length_counter = (uint8_t)(64u - (val & 0x3Fu));
+        break;
+    case 0xFF16:
+        a->ch2.length_counter = (uint8_t)(64u - (val & 0x3Fu));
+        break;
+    case 0xFF1B:
+        a->ch3.length_counter = (uint16_t)(256u - val);
+        break;
+    case 0xFF20:
+        a->ch4.length_counter = (uint8_t)(64u - (val & 0x3Fu));
+        break;
+    default:
+        break;
     }
 }
 
 static void apu_on_write(apu a, uint16_t addr, uint8_t val) {
+    if (addr >= APU_REG_BASE + WAVE_RAM_INDEX) {
+        a->regs[addr - APU_REG_BASE] = val;
+        return;
+    }
+
     if (addr == 0xFF26u) {
         bool want_on = (val & 0x80u) != 0u;
         if (!want_on && a->master_on) {
@@ -667,9 +831,12 @@ static void apu_on_write(apu a, uint16_t addr, uint8_t val) {
     }
 
     if (!a->master_on) {
+        apu_write_while_off(a, addr, val);
         return;
     }
 
+    a->regs[addr - APU_REG_BASE] = val;
+
     switch (addr) {
     case 0xFF10:
         a->ch1.nrx0 = val;
@@ -762,147 +929,345 @@ static void apu_on_write(apu a, uint16_t addr, uint8_t val) {
         }
         break;
 
+    case 0xFF24:
+    case 0xFF25:
+        apu_refresh_gains(a);
+        break;
+
     default:
         break;
     }
 }
 
-static void apu_process_io_writes(apu a) {
-    uint16_t addr;
-    for (addr = 0xFF10u; addr <= 0xFF3Fu; addr++) {
-        uint8_t idx = (uint8_t)(addr - 0xFF00u);
-        uint32_t serial = bus_get_io_write_serial(a->mbus, addr);
-        if (serial != a->io_seen[idx]) {
-            a->io_seen[idx] = serial;
-            apu_on_write(a, addr, bus_read8(a->mbus, addr));
-        }
+static uint8_t apu_io_read(void *ctx, uint16_t addr) {
+    apu a = (apu)ctx;
+    uint8_t idx = (uint8_t)(addr - APU_REG_BASE);
+
+    if (idx == NR52_INDEX) {
+        PROF_ENTER(PROF_APU);
+        apu_sync(a);
+        PROF_LEAVE();
+        uint8_t status = a->master_on ? 0x80u : 0x00u;
+        if (a->ch1.enabled) status |= 0x01u;
+        if (a->ch2.enabled) status |= 0x02u;
+        if (a->ch3.enabled) status |= 0x04u;
+        if (a->ch4.enabled) status |= 0x08u;
+        return (uint8_t)(status | apu_read_masks[idx]);
     }
+    return (uint8_t)(a->regs[idx] | apu_read_masks[idx]);
 }
 
-static void apu_step_counters(apu a, int cpu_cycles) {
-    if (!a->master_on || cpu_cycles <= 0) {
-        return;
+// Catches up to cycle and applies one CPU write. The emulation thread and
+// the audio thread's replay both go through here, which is what keeps
+// threaded output identical to the single-threaded path.
+static void apu_apply_write(apu a, uint64_t cycle, uint16_t addr, uint8_t val) {
+    apu_run(a, cycle);
+    if (addr >= 0xFF24u && addr <= 0xFF26u) {
+        apu_render(a);      // mixer state changes apply from this sample on
     }
-
-    apu_frame_step(a, cpu_cycles);
-    square_step_timer(&a->ch1, cpu_cycles);
-    square_step_timer(&a->ch2, cpu_cycles);
-    wave_step_timer(&a->ch3, cpu_cycles);
-    noise_step_timer(&a->ch4, cpu_cycles);
+    apu_on_write(a, addr, val);
+    apu_update_amps(a);
 }
 
-#endif
+static void apu_finish_frame(apu a, uint64_t cycle) {
+    apu_run(a, cycle);
+    apu_render(a);
+    if (a->synth) {
+        apu_flush_samples(a);
+        apu_sink_end_frame(a->sink);
+    }
+}
 
-apu apu_init(bus b) {
-    apu a = (apu)calloc(1, sizeof(struct APU));
-    if (a == NULL) {
-        return NULL;
+static void apu_store_rate_adjust(apu a, double ratio) {
+    if (ratio != a->rate_adjust) {
+        a->rate_adjust = ratio;
+        a->rate_pending = true;
     }
+}
 
-    a->mbus = b;
+// --- audio thread ---
+
+// The worker owns a second APU (with the sink and step buffers) and
+// replays the log against it. The log is the only channel between the
+// threads; the emulation side wakes the worker once per frame, or early
+// when the log fills up.
+struct apu_worker {
+    apu synth;
+    spsc_ring log;
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    bool pending;               // guarded by lock
+    bool quit;                  // guarded by lock
+};
 
-#ifdef EASYGB_USE_SDL
-    a->master_on = (bus_read8(b, 0xFF26) & 0x80u) != 0u;
-    apu_reset_runtime(a);
-    if (a->master_on) {
-        apu_sync_regs_from_bus(a);
+void apu_replay(apu a, const struct apu_log_entry *e) {
+    switch (e->kind) {
+    case APU_LOG_WRITE:
+        apu_apply_write(a, e->cycle, e->addr, e->value);
+        break;
+    case APU_LOG_END_FRAME:
+        apu_finish_frame(a, e->cycle);
+        break;
+    case APU_LOG_RATE:
+        apu_store_rate_adjust(a, e->ratio);
+        break;
+    default:
+        break;
     }
+}
 
-    {
-        int i;
-        for (i = 0; i < 0x80; i++) {
-            a->io_seen[i] = bus_get_io_write_serial(b, (uint16_t)(0xFF00u + (uint16_t)i));
+static void *apu_worker_main(void *arg) {
+    struct apu_worker *w = (struct apu_worker *)arg;
+    struct apu_log_entry batch[APU_LOG_BATCH];
+
+    for (;;) {
+        pthread_mutex_lock(&w->lock);
+        while (!w->pending && !w->quit) {
+            pthread_cond_wait(&w->wake, &w->lock);
+        }
+        bool quit = w->quit;
+        w->pending = false;
+        pthread_mutex_unlock(&w->lock);
+
+        // Everything logged before quit was raised is read here.
+        size_t n;
+        while ((n = spsc_ring_read(w->log, batch, APU_LOG_BATCH)) > 0u) {
+            for (size_t i = 0; i < n; i++) {
+                apu_replay(w->synth, &batch[i]);
+            }
+        }
+        if (quit) {
+            return NULL;
         }
     }
+}
 
-    if ((SDL_WasInit(SDL_INIT_AUDIO) & SDL_INIT_AUDIO) == 0u) {
-        if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
-            dbg_log("APU: SDL audio init failed: %s", SDL_GetError());
-            return a;
-        }
+static void apu_worker_signal(struct apu_worker *w, bool quit) {
+    pthread_mutex_lock(&w->lock);
+    w->pending = true;
+    w->quit = w->quit || quit;
+    pthread_cond_signal(&w->wake);
+    pthread_mutex_unlock(&w->lock);
+}
+
+// Never drops an entry: on a full log the emulation thread waits for the
+// worker to catch up.
+static void apu_worker_push(struct apu_worker *w, const struct apu_log_entry *e) {
+    while (spsc_ring_write(w->log, e, 1u) == 0u) {
+        apu_worker_signal(w, false);
+        sched_yield();
     }
+}
 
-    {
-        SDL_AudioSpec want;
-        SDL_zero(want);
-        want.freq = APU_SAMPLE_RATE;
-        want.format = AUDIO_F32SYS;
-        want.channels = 2;
-        want.samples = 1024;
-        want.callback = NULL;
-
-        a->dev = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
-        if (a->dev == 0) {
-            dbg_log("APU: SDL_OpenAudioDevice failed: %s", SDL_GetError());
-            return a;
-        }
+static struct apu_worker *apu_worker_start(apu synth) {
+    struct apu_worker *w = (struct apu_worker *)calloc(1, sizeof(struct apu_worker));
+    if (w == NULL) {
+        perror("[ERROR] Failed APU worker allocation!");
+        exit(EXIT_FAILURE);
     }
 
-    SDL_PauseAudioDevice(a->dev, 0);
-    a->audio_ready = true;
-    dbg_log("APU init complete");
-#else
-    (void)b;
-#endif
+    w->synth = synth;
+    w->log = spsc_ring_new(APU_LOG_CAPACITY, sizeof(struct apu_log_entry));
+    pthread_mutex_init(&w->lock, NULL);
+    pthread_cond_init(&w->wake, NULL);
+    if (pthread_create(&w->thread, NULL, apu_worker_main, w) != 0) {
+        perror("[ERROR] Failed APU thread creation!");
+        exit(EXIT_FAILURE);
+    }
+    return w;
+}
 
-    return a;
+// Drains the log and joins the thread; returns the worker's APU.
+static apu apu_worker_stop(struct apu_worker *w) {
+    apu synth = w->synth;
+
+    apu_worker_signal(w, true);
+    pthread_join(w->thread, NULL);
+    pthread_cond_destroy(&w->wake);
+    pthread_mutex_destroy(&w->lock);
+    spsc_ring_free(w->log);
+    free(w);
+    return synth;
 }
 
-void apu_destroy(apu a) {
+// --- bus hooks and setup ---
+
+// Passes an event on to the audio thread and the capture file.
+static void apu_forward(apu a, const struct apu_log_entry *e) {
+    if (a->worker != NULL) {
+        apu_worker_push(a->worker, e);
+    }
+    if (a->capture != NULL) {
+        apu_log_append(a->capture, e);
+    }
+}
+
+static void apu_io_write(void *ctx, uint16_t addr, uint8_t val) {
+    apu a = (apu)ctx;
+    uint64_t now = bus_get_cycles(a->mbus);
+    PROF_ENTER(PROF_APU);
+
+    apu_apply_write(a, now, addr, val);
+    if (a->worker != NULL || a->capture != NULL) {
+        struct apu_log_entry e = {.cycle = now, .addr = addr, .value = val, .kind = APU_LOG_WRITE};
+        apu_forward(a, &e);
+    }
+    PROF_LEAVE();
+}
+
+static int sample_rate_from_env(void) {
+    const char *v = getenv("EASYGB_AUDIO_RATE");
+    int rate = v != NULL ? atoi(v) : 0;
+
+    if (rate <= 0) {
+        return APU_SAMPLE_RATE;
+    }
+    if (rate < APU_MIN_SAMPLE_RATE) rate = APU_MIN_SAMPLE_RATE;
+    if (rate > APU_MAX_SAMPLE_RATE) rate = APU_MAX_SAMPLE_RATE;
+    return rate;
+}
+
+static enum blip_quality quality_from_env(void) {
+    const char *v = getenv("EASYGB_AUDIO_QUALITY");
+    enum blip_quality q = BLIP_QUALITY_SINC16;
+
+    if (v != NULL && v[0] != '\0' && !blip_quality_parse(v, &q)) {
+        dbg_log("APU: unknown EASYGB_AUDIO_QUALITY '%s', using %s", v, blip_quality_name(q));
+    }
+    return q;
+}
+
+// EASYGB_AUDIO_THREAD=1 moves synthesis to its own thread.
+static bool audio_thread_requested(void) {
+    const char *v = getenv("EASYGB_AUDIO_THREAD");
+    return v != NULL && strcmp(v, "1") == 0;
+}
+
+apu apu_init(bus b) {
+    return apu_init_with_spec(b, getenv("EASYGB_AUDIO"));
+}
+
+apu apu_init_with_spec(bus b, const char *spec) {
+    return apu_init_with_sink(b, apu_sink_open(spec, sample_rate_from_env()));
+}
+
+// One APU core starting from the register file regs at clock time.
+static apu apu_new(apu_sink sink, const uint8_t *regs, uint64_t time, bool synth,
+                   enum blip_quality quality) {
+    apu a = (apu)calloc(1, sizeof(struct APU));
     if (a == NULL) {
-        return;
+        perror("[ERROR] Failed APU allocation!");
+        exit(EXIT_FAILURE);
     }
 
-#ifdef EASYGB_USE_SDL
-    if (a->audio_ready && a->dev != 0) {
-        if (a->mix_count > 0) {
-            SDL_QueueAudio(a->dev, a->mixbuf, (uint32_t)(a->mix_count * 2 * (int)sizeof(float)));
-            a->mix_count = 0;
+    a->sink = sink;
+    a->synth = synth;
+    a->rate_adjust = 1.0;
+    memcpy(a->regs, regs, sizeof(a->regs));
+    a->time = time;
+    a->block_start = a->time;
+
+    if (synth) {
+        for (int c = 0; c < APU_CHANNELS; c++) {
+            a->blip[c] = blip_new(GB_CPU_HZ, sink->sample_rate, quality);
         }
-        SDL_CloseAudioDevice(a->dev);
     }
-#endif
 
+    a->master_on = (a->regs[NR52_INDEX] & 0x80u) != 0u;
+    apu_reset_runtime(a);
+    if (a->master_on) {
+        apu_load_channel_regs(a);
+    }
+    apu_refresh_gains(a);
+    return a;
+}
+
+static void apu_free(apu a) {
+    for (int c = 0; c < APU_CHANNELS; c++) {
+        blip_free(a->blip[c]);
+    }
     free(a);
 }
 
-void apu_step(apu a, int cpu_cycles) {
-    if (a == NULL || cpu_cycles <= 0) {
-        return;
+// Takes over FF10-FF3F from the bus, starting from whatever it holds
+// (post-boot values, or zeros under the boot ROM).
+apu apu_init_with_sink(bus b, apu_sink sink) {
+    const uint8_t *regs = &bus_get_io(b)[APU_REG_BASE - 0xFF00];
+    uint64_t now = bus_get_cycles(b);
+    enum blip_quality quality = quality_from_env();
+    bool threaded = sink->wants_samples && audio_thread_requested();
+
+    apu a = apu_new(sink, regs, now, sink->wants_samples && !threaded, quality);
+    a->mbus = b;
+    if (threaded) {
+        a->worker = apu_worker_start(apu_new(sink, regs, now, true, quality));
     }
 
-#ifdef EASYGB_USE_SDL
-    if (!a->audio_ready || a->dev == 0) {
-        return;
+    const char *capture = getenv("EASYGB_APU_LOG");
+    if (capture != NULL && capture[0] != '\0') {
+        a->capture = apu_log_create(capture, now, regs);
+        dbg_log("APU: logging register writes to %s", capture);
     }
 
-    apu_process_io_writes(a);
-    apu_step_counters(a, cpu_cycles);
+    bus_set_apu_io(b, apu_io_read, apu_io_write, a);
+    dbg_log("APU init complete (%s, %d Hz, %s steps, %s mixer)",
+            !sink->wants_samples ? "registers only" : threaded ? "mixing on audio thread" : "mixing",
+            sink->sample_rate, sink->wants_samples ? blip_quality_name(quality) : "no",
+            apu_mix_kernel_name());
+    return a;
+}
+
+// Replay needs no bus: time only advances through the entries fed in.
+apu apu_init_detached(const char *spec, const uint8_t *regs, uint64_t cycle) {
+    apu_sink sink = apu_sink_open(spec, sample_rate_from_env());
+    return apu_new(sink, regs, cycle, sink->wants_samples, quality_from_env());
+}
+
+void apu_destroy(apu a) {
+    if (a == NULL) {
+        return;
+    }
 
-    a->sample_accum += (uint64_t)cpu_cycles * (uint64_t)APU_SAMPLE_RATE;
+    apu_end_frame(a);
+    if (a->worker != NULL) {
+        apu synth = apu_worker_stop(a->worker);
+        apu_flush_samples(synth);
+        apu_free(synth);
+    }
+    apu_flush_samples(a);
+    apu_sink_close(a->sink);
+    apu_log_close(a->capture);
+    apu_free(a);
+}
 
-    while (a->sample_accum >= (uint64_t)GB_CPU_HZ) {
-        float left;
-        float right;
+void apu_end_frame(apu a) {
+    uint64_t now = a->mbus != NULL ? bus_get_cycles(a->mbus) : a->time;
+    PROF_ENTER(PROF_APU);
 
-        a->sample_accum -= (uint64_t)GB_CPU_HZ;
+    apu_finish_frame(a, now);
+    if (a->worker != NULL || a->capture != NULL) {
+        struct apu_log_entry e = {.cycle = now, .kind = APU_LOG_END_FRAME};
+        apu_forward(a, &e);
+    }
+    if (a->worker != NULL) {
+        apu_worker_signal(a->worker, false);
+    }
+    PROF_LEAVE();
+}
 
-        apu_mix_sample(a, &left, &right);
-        a->mixbuf[a->mix_count * 2] = left;
-        a->mixbuf[a->mix_count * 2 + 1] = right;
-        a->mix_count++;
+apu_sink apu_get_sink(apu a) {
+    return a->sink;
+}
 
-        if (a->mix_count >= APU_BATCH_SAMPLES) {
-            uint32_t queued = SDL_GetQueuedAudioSize(a->dev);
-            uint32_t hard_limit = (uint32_t)(APU_SAMPLE_RATE * 2 * (int)sizeof(float) / 2); // ~500ms
-            if (queued > hard_limit) {
-                SDL_ClearQueuedAudio(a->dev);
-            }
-            SDL_QueueAudio(a->dev, a->mixbuf, (uint32_t)(a->mix_count * 2 * (int)sizeof(float)));
-            a->mix_count = 0;
-        }
+// ratio > 1 produces more samples per emulated second. Clamped to the
+// +-0.5% that stays inaudible.
+void apu_set_rate_adjust(apu a, double ratio) {
+    if (ratio < 1.0 - APU_MAX_RATE_ADJUST) ratio = 1.0 - APU_MAX_RATE_ADJUST;
+    if (ratio > 1.0 + APU_MAX_RATE_ADJUST) ratio = 1.0 + APU_MAX_RATE_ADJUST;
+    if (ratio != a->rate_adjust) {
+        struct apu_log_entry e = {.cycle = bus_get_cycles(a->mbus), .ratio = ratio, .kind = APU_LOG_RATE};
+        apu_forward(a, &e);
     }
-#else
-    (void)a;
-#endif
+    apu_store_rate_adjust(a, ratio);
 }
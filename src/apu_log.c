@@ -0,0 +1,155 @@
+#include "include/apu_log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    APU_LOG_VERSION = 2,        // 2: rate changes; 1 still opens
+    APU_LOG_MAGIC_SIZE = 6,
+    APU_LOG_FILE_RATE = 0xFE,
+    APU_LOG_FILE_END_FRAME = 0xFF
+};
+
+static const char apu_log_magic[APU_LOG_MAGIC_SIZE] = {'E', 'G', 'B', 'A', 'P', 'U'};
+
+static apu_log_file apu_log_alloc(FILE *f, uint64_t start_cycle) {
+    apu_log_file l = (apu_log_file)calloc(1, sizeof(struct APULogFile));
+    if (l == NULL) {
+        perror("[ERROR] Failed APU log allocation!");
+        exit(EXIT_FAILURE);
+    }
+    l->f = f;
+    l->last_cycle = start_cycle;
+    return l;
+}
+
+apu_log_file apu_log_create(const char *path, uint64_t start_cycle, const uint8_t *regs) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        perror("[ERROR] Unable to create APU log");
+        return NULL;
+    }
+
+    uint8_t head[APU_LOG_MAGIC_SIZE + 2 + 8];
+    memcpy(head, apu_log_magic, APU_LOG_MAGIC_SIZE);
+    head[APU_LOG_MAGIC_SIZE] = APU_LOG_VERSION;
+    head[APU_LOG_MAGIC_SIZE + 1] = 0;
+    for (int i = 0; i < 8; i++) {
+        head[APU_LOG_MAGIC_SIZE + 2 + i] = (uint8_t)(start_cycle >> (8 * i));
+    }
+    fwrite(head, 1, sizeof(head), f);
+    fwrite(regs, 1, APU_LOG_REG_COUNT, f);
+    return apu_log_alloc(f, start_cycle);
+}
+
+apu_log_file apu_log_open(const char *path, uint64_t *start_cycle, uint8_t *regs) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror("[ERROR] Unable to open APU log");
+        return NULL;
+    }
+
+    uint8_t head[APU_LOG_MAGIC_SIZE + 2 + 8];
+    if (fread(head, 1, sizeof(head), f) != sizeof(head) ||
+        memcmp(head, apu_log_magic, APU_LOG_MAGIC_SIZE) != 0 ||
+        head[APU_LOG_MAGIC_SIZE] < 1u || head[APU_LOG_MAGIC_SIZE] > APU_LOG_VERSION ||
+        fread(regs, 1, APU_LOG_REG_COUNT, f) != APU_LOG_REG_COUNT) {
+        fprintf(stderr, "[ERROR] %s is not an APU log\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    *start_cycle = 0;
+    for (int i = 0; i < 8; i++) {
+        *start_cycle |= (uint64_t)head[APU_LOG_MAGIC_SIZE + 2 + i] << (8 * i);
+    }
+    return apu_log_alloc(f, *start_cycle);
+}
+
+void apu_log_append(apu_log_file l, const struct apu_log_entry *e) {
+    uint8_t rec[24];
+    int n = 0;
+
+    uint64_t delta = e->cycle - l->last_cycle;
+    l->last_cycle = e->cycle;
+    do {
+        uint8_t b = (uint8_t)(delta & 0x7Fu);
+        delta >>= 7;
+        rec[n++] = delta != 0u ? (uint8_t)(b | 0x80u) : b;
+    } while (delta != 0u);
+
+    if (e->kind == APU_LOG_END_FRAME) {
+        rec[n++] = APU_LOG_FILE_END_FRAME;
+    } else if (e->kind == APU_LOG_RATE) {
+        uint64_t bits;
+        memcpy(&bits, &e->ratio, sizeof(bits));
+        rec[n++] = APU_LOG_FILE_RATE;
+        for (int i = 0; i < 8; i++) {
+            rec[n++] = (uint8_t)(bits >> (8 * i));
+        }
+    } else {
+        rec[n++] = (uint8_t)(e->addr - APU_LOG_REG_BASE);
+        rec[n++] = e->value;
+    }
+    fwrite(rec, 1, (size_t)n, l->f);
+}
+
+bool apu_log_next(apu_log_file l, struct apu_log_entry *e) {
+    uint64_t delta = 0;
+    int shift = 0;
+    int c;
+
+    do {
+        c = fgetc(l->f);
+        if (c == EOF) {
+            return false;
+        }
+        if (shift < 64) {
+            delta |= (uint64_t)(c & 0x7F) << shift;
+        }
+        shift += 7;
+    } while ((c & 0x80) != 0);
+
+    int code = fgetc(l->f);
+    if (code == EOF) {
+        return false;
+    }
+
+    memset(e, 0, sizeof(*e));
+    l->last_cycle += delta;
+    e->cycle = l->last_cycle;
+    if (code == APU_LOG_FILE_END_FRAME) {
+        e->kind = APU_LOG_END_FRAME;
+        return true;
+    }
+    if (code == APU_LOG_FILE_RATE) {
+        uint8_t raw[8];
+        if (fread(raw, 1, sizeof(raw), l->f) != sizeof(raw)) {
+            return false;
+        }
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; i++) {
+            bits |= (uint64_t)raw[i] << (8 * i);
+        }
+        e->kind = APU_LOG_RATE;
+        memcpy(&e->ratio, &bits, sizeof(e->ratio));
+        return true;
+    }
+
+    int value = fgetc(l->f);
+    if (value == EOF || code >= APU_LOG_REG_COUNT) {
+        return false;
+    }
+    e->kind = APU_LOG_WRITE;
+    e->addr = (uint16_t)(APU_LOG_REG_BASE + code);
+    e->value = (uint8_t)value;
+    return true;
+}
+
+void apu_log_close(apu_log_file l) {
+    if (l == NULL) {
+        return;
+    }
+    fclose(l->f);
+    free(l);
+}
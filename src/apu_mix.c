@@ -0,0 +1,236 @@
+#include "include/apu_mix.h"
+#include "include/blip.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define APU_MIX_HAVE_AVX2 1
+#endif
+
+enum {
+    LEVEL_SHIFT = 5,            // BLIP_UNIT levels -> 1024 per 1/15 step (fits s16)
+    MIX_FRAC_BITS = 12,         // mixed samples are s16 in Q12
+    HPF_REF_RATE = 48000        // the pole is 0.996 at this rate
+};
+
+// Gain of one unit of (level >> LEVEL_SHIFT) at NR50 volume 1..8, in Q12:
+// full scale per channel is 0.22 of s16 at volume 8.
+static inline int16_t channel_gain(unsigned vol) {
+    const float per_unit = 0.22f * 32767.0f * (float)(1 << MIX_FRAC_BITS) /
+                           (15.0f * 8.0f * (float)(BLIP_UNIT >> LEVEL_SHIFT));
+    return (int16_t)((float)vol * per_unit + 0.5f);
+}
+
+void apu_mix_set_gains(struct apu_mix_gains *g, uint8_t nr50, uint8_t nr51) {
+    int16_t lgain = channel_gain(((nr50 >> 4) & 0x07u) + 1u);
+    int16_t rgain = channel_gain((nr50 & 0x07u) + 1u);
+
+    for (int c = 0; c < APU_MIX_CHANNELS; c++) {
+        g->left[c] = (nr51 & (0x10u << c)) != 0u ? lgain : 0;
+        g->right[c] = (nr51 & (0x01u << c)) != 0u ? rgain : 0;
+    }
+}
+
+// --- routing and volume: channel levels -> Q12 left/right ---
+
+typedef void (*route_fn)(const struct apu_mix_gains *g, const int32_t *const ch[APU_MIX_CHANNELS],
+                         int32_t *l, int32_t *r, int count);
+
+static void route_scalar_range(const struct apu_mix_gains *g, const int32_t *const ch[APU_MIX_CHANNELS],
+                               int32_t *l, int32_t *r, int from, int count) {
+    for (int i = from; i < count; i++) {
+        int32_t sl = 0;
+        int32_t sr = 0;
+        for (int c = 0; c < APU_MIX_CHANNELS; c++) {
+            int32_t v = ch[c][i] >> LEVEL_SHIFT;
+            sl += v * g->left[c];
+            sr += v * g->right[c];
+        }
+        l[i] = sl;
+        r[i] = sr;
+    }
+}
+
+static void route_scalar(const struct apu_mix_gains *g, const int32_t *const ch[APU_MIX_CHANNELS],
+                         int32_t *l, int32_t *r, int count) {
+    route_scalar_range(g, ch, l, r, 0, count);
+}
+
+#if defined(__SSE2__)
+
+static inline __m128i gain_pair128(int16_t a, int16_t b) {
+    return _mm_set1_epi32((int32_t)(((uint32_t)(uint16_t)b << 16) | (uint16_t)a));
+}
+
+static inline __m128i load_levels128(const int32_t *p) {
+    __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)p), LEVEL_SHIFT);
+    __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(p + 4)), LEVEL_SHIFT);
+    return _mm_packs_epi32(lo, hi);
+}
+
+// Eight samples per pass: channels are packed to s16 and interleaved in
+// pairs so one madd applies both gains of a pair.
+static void route_sse2(const struct apu_mix_gains *g, const int32_t *const ch[APU_MIX_CHANNELS],
+                       int32_t *l, int32_t *r, int count) {
+    __m128i gl01 = gain_pair128(g->left[0], g->left[1]);
+    __m128i gl23 = gain_pair128(g->left[2], g->left[3]);
+    __m128i gr01 = gain_pair128(g->right[0], g->right[1]);
+    __m128i gr23 = gain_pair128(g->right[2], g->right[3]);
+    int i = 0;
+
+    for (; i + 8 <= count; i += 8) {
+        __m128i c0 = load_levels128(ch[0] + i);
+        __m128i c1 = load_levels128(ch[1] + i);
+        __m128i c2 = load_levels128(ch[2] + i);
+        __m128i c3 = load_levels128(ch[3] + i);
+        __m128i lo01 = _mm_unpacklo_epi16(c0, c1);
+        __m128i hi01 = _mm_unpackhi_epi16(c0, c1);
+        __m128i lo23 = _mm_unpacklo_epi16(c2, c3);
+        __m128i hi23 = _mm_unpackhi_epi16(c2, c3);
+
+        _mm_storeu_si128((__m128i *)(l + i),
+                         _mm_add_epi32(_mm_madd_epi16(lo01, gl01), _mm_madd_epi16(lo23, gl23)));
+        _mm_storeu_si128((__m128i *)(l + i + 4),
+                         _mm_add_epi32(_mm_madd_epi16(hi01, gl01), _mm_madd_epi16(hi23, gl23)));
+        _mm_storeu_si128((__m128i *)(r + i),
+                         _mm_add_epi32(_mm_madd_epi16(lo01, gr01), _mm_madd_epi16(lo23, gr23)));
+        _mm_storeu_si128((__m128i *)(r + i + 4),
+                         _mm_add_epi32(_mm_madd_epi16(hi01, gr01), _mm_madd_epi16(hi23, gr23)));
+    }
+
+    route_scalar_range(g, ch, l, r, i, count);
+}
+
+#endif
+
+#ifdef APU_MIX_HAVE_AVX2
+
+__attribute__((target("avx2")))
+static inline __m256i gain_pair256(int16_t a, int16_t b) {
+    return _mm256_set1_epi32((int32_t)(((uint32_t)(uint16_t)b << 16) | (uint16_t)a));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i load_levels256(const int32_t *p) {
+    __m256i lo = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)p), LEVEL_SHIFT);
+    __m256i hi = _mm256_srai_epi32(_mm256_loadu_si256((const __m256i *)(p + 8)), LEVEL_SHIFT);
+    return _mm256_packs_epi32(lo, hi);
+}
+
+// Sixteen samples per pass. packs/unpack work per 128-bit lane, which
+// leaves unpacklo holding samples 0-7 and unpackhi samples 8-15 in order.
+__attribute__((target("avx2")))
+static void route_avx2(const struct apu_mix_gains *g, const int32_t *const ch[APU_MIX_CHANNELS],
+                       int32_t *l, int32_t *r, int count) {
+    __m256i gl01 = gain_pair256(g->left[0], g->left[1]);
+    __m256i gl23 = gain_pair256(g->left[2], g->left[3]);
+    __m256i gr01 = gain_pair256(g->right[0], g->right[1]);
+    __m256i gr23 = gain_pair256(g->right[2], g->right[3]);
+    int i = 0;
+
+    for (; i + 16 <= count; i += 16) {
+        __m256i c0 = load_levels256(ch[0] + i);
+        __m256i c1 = load_levels256(ch[1] + i);
+        __m256i c2 = load_levels256(ch[2] + i);
+        __m256i c3 = load_levels256(ch[3] + i);
+        __m256i lo01 = _mm256_unpacklo_epi16(c0, c1);
+        __m256i hi01 = _mm256_unpackhi_epi16(c0, c1);
+        __m256i lo23 = _mm256_unpacklo_epi16(c2, c3);
+        __m256i hi23 = _mm256_unpackhi_epi16(c2, c3);
+
+        _mm256_storeu_si256((__m256i *)(l + i),
+                            _mm256_add_epi32(_mm256_madd_epi16(lo01, gl01), _mm256_madd_epi16(lo23, gl23)));
+        _mm256_storeu_si256((__m256i *)(l + i + 8),
+                            _mm256_add_epi32(_mm256_madd_epi16(hi01, gl01), _mm256_madd_epi16(hi23, gl23)));
+        _mm256_storeu_si256((__m256i *)(r + i),
+                            _mm256_add_epi32(_mm256_madd_epi16(lo01, gr01), _mm256_madd_epi16(lo23, gr23)));
+        _mm256_storeu_si256((__m256i *)(r + i + 8),
+                            _mm256_add_epi32(_mm256_madd_epi16(hi01, gr01), _mm256_madd_epi16(hi23, gr23)));
+    }
+
+    route_scalar_range(g, ch, l, r, i, count);
+}
+
+#endif
+
+static route_fn route_impl = NULL;
+static const char *route_name = "scalar";
+
+// EASYGB_MIX_KERNEL=scalar|sse2|avx2 overrides the CPU-based pick.
+static void pick_route(void) {
+    const char *want = getenv("EASYGB_MIX_KERNEL");
+    route_impl = route_scalar;
+    route_name = "scalar";
+
+    if (want != NULL && strcmp(want, "scalar") == 0) {
+        return;
+    }
+#if defined(__SSE2__)
+    route_impl = route_sse2;
+    route_name = "sse2";
+    if (want != NULL && strcmp(want, "sse2") == 0) {
+        return;
+    }
+#endif
+#ifdef APU_MIX_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        route_impl = route_avx2;
+        route_name = "avx2";
+    }
+#endif
+}
+
+// --- DC blocker and s16 output ---
+
+void apu_hpf_init(struct apu_hpf *h, int sample_rate) {
+    if (sample_rate <= 0) {
+        sample_rate = HPF_REF_RATE;
+    }
+    memset(h, 0, sizeof(*h));
+    h->coeff = (int32_t)((1.0 - 0.004 * HPF_REF_RATE / sample_rate) * 65536.0 + 0.5);
+}
+
+static inline int16_t hpf_step(struct apu_hpf *h, int side, int32_t x) {
+    int32_t y = x - h->prev_in[side] + (int32_t)(((int64_t)h->prev_out[side] * h->coeff) >> 16);
+    h->prev_in[side] = x;
+    h->prev_out[side] = y;
+
+    int32_t s = (y + (1 << (MIX_FRAC_BITS - 1))) >> MIX_FRAC_BITS;
+    if (s > INT16_MAX) return INT16_MAX;
+    if (s < INT16_MIN) return INT16_MIN;
+    return (int16_t)s;
+}
+
+void apu_mix_block(const struct apu_mix_gains *g, struct apu_hpf *hpf,
+                   const int32_t *const chan[APU_MIX_CHANNELS], int16_t *out, int count) {
+    int32_t l[APU_MIX_MAX_BLOCK];
+    int32_t r[APU_MIX_MAX_BLOCK];
+
+    if (route_impl == NULL) {
+        pick_route();
+    }
+    if (count > APU_MIX_MAX_BLOCK) {
+        count = APU_MIX_MAX_BLOCK;
+    }
+
+    route_impl(g, chan, l, r, count);
+
+    // The filter is a recurrence over time, so it stays a scalar pass.
+    for (int i = 0; i < count; i++) {
+        out[i * 2] = hpf_step(hpf, 0, l[i]);
+        out[i * 2 + 1] = hpf_step(hpf, 1, r[i]);
+    }
+}
+
+const char *apu_mix_kernel_name(void) {
+    if (route_impl == NULL) {
+        pick_route();
+    }
+    return route_name;
+}
@@ -0,0 +1,365 @@
+#include "include/apu_sink.h"
+#include "include/debug.h"
+#include "include/spsc_ring.h"
+
+#ifdef EASYGB_USE_SDL
+#include <SDL2/SDL.h>
+#endif
+
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    WAV_HEADER_BYTES = 44,
+    SINK_CHANNELS = 2,
+    SINK_FRAME_BYTES = SINK_CHANNELS * (int)sizeof(int16_t)
+};
+
+static apu_sink sink_alloc(enum apu_sink_kind kind, int sample_rate) {
+    apu_sink s = (apu_sink)calloc(1, sizeof(struct APUSink));
+    if (s == NULL) {
+        perror("[ERROR] Failed APU sink allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    s->kind = kind;
+    s->sample_rate = sample_rate;
+    s->wants_samples = kind != APU_SINK_NULL;
+    return s;
+}
+
+// --- null ---
+
+static void null_write(apu_sink s, const int16_t *frames, size_t frame_count) {
+    (void)s;
+    (void)frames;
+    (void)frame_count;
+}
+
+static void null_close(apu_sink s) {
+    (void)s;
+}
+
+apu_sink apu_sink_null(void) {
+    apu_sink s = sink_alloc(APU_SINK_NULL, 0);
+    s->write = null_write;
+    s->close = null_close;
+    return s;
+}
+
+// --- WAV / raw PCM files ---
+
+static void put_le16(uint8_t *dst, uint16_t v) {
+    dst[0] = (uint8_t)(v & 0xFFu);
+    dst[1] = (uint8_t)(v >> 8);
+}
+
+static void put_le32(uint8_t *dst, uint32_t v) {
+    put_le16(dst, (uint16_t)(v & 0xFFFFu));
+    put_le16(dst + 2, (uint16_t)(v >> 16));
+}
+
+// Header for data_bytes of s16 stereo; rewritten with the final size on close.
+static void write_wav_header(FILE *f, int sample_rate, uint32_t data_bytes) {
+    uint8_t h[WAV_HEADER_BYTES];
+    memcpy(&h[0], "RIFF", 4);
+    put_le32(&h[4], 36u + data_bytes);
+    memcpy(&h[8], "WAVEfmt ", 8);
+    put_le32(&h[16], 16u);
+    put_le16(&h[20], 1u);                   // PCM
+    put_le16(&h[22], SINK_CHANNELS);
+    put_le32(&h[24], (uint32_t)sample_rate);
+    put_le32(&h[28], (uint32_t)sample_rate * SINK_FRAME_BYTES);
+    put_le16(&h[32], SINK_FRAME_BYTES);
+    put_le16(&h[34], 16u);
+    memcpy(&h[36], "data", 4);
+    put_le32(&h[40], data_bytes);
+
+    fseek(f, 0, SEEK_SET);
+    fwrite(h, 1, sizeof(h), f);
+}
+
+static void file_write(apu_sink s, const int16_t *frames, size_t frame_count) {
+    FILE *f = (FILE *)s->ctx;
+    uint8_t le[1024 * 2];
+    size_t samples = frame_count * SINK_CHANNELS;
+
+    while (samples > 0u) {
+        size_t chunk = samples < 1024u ? samples : 1024u;
+        for (size_t i = 0; i < chunk; i++) {
+            put_le16(&le[i * 2u], (uint16_t)frames[i]);
+        }
+        fwrite(le, 2, chunk, f);
+        frames += chunk;
+        samples -= chunk;
+    }
+}
+
+static void file_close(apu_sink s) {
+    FILE *f = (FILE *)s->ctx;
+    if (s->kind == APU_SINK_WAV) {
+        write_wav_header(f, s->sample_rate, (uint32_t)(s->frames_written * SINK_FRAME_BYTES));
+    }
+    fclose(f);
+}
+
+static apu_sink file_sink_open(enum apu_sink_kind kind, const char *path, int sample_rate) {
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        fprintf(stderr, "[ERROR] Cannot open audio output '%s'\n", path);
+        return NULL;
+    }
+
+    apu_sink s = sink_alloc(kind, sample_rate);
+    s->write = file_write;
+    s->close = file_close;
+    s->ctx = f;
+    if (kind == APU_SINK_WAV) {
+        write_wav_header(f, sample_rate, 0u);
+    }
+    return s;
+}
+
+apu_sink apu_sink_wav(const char *path, int sample_rate) {
+    return file_sink_open(APU_SINK_WAV, path, sample_rate);
+}
+
+apu_sink apu_sink_raw(const char *path, int sample_rate) {
+    return file_sink_open(APU_SINK_RAW, path, sample_rate);
+}
+
+// --- SDL pull callback ---
+
+enum {
+    SDL_DEFAULT_LATENCY_MS = 40,
+    SDL_MIN_LATENCY_MS = 10,
+    SDL_MAX_LATENCY_MS = 500,
+    SDL_GB_CPU_HZ = 4194304,
+    SDL_GB_FRAME_CYCLES = 70224
+};
+
+#ifdef EASYGB_USE_SDL
+
+// The emulation thread (or the APU's own thread) writes into ring; SDL's
+// audio thread drains it.
+// Playback starts once target_frames are buffered, and the producer never
+// queues more than max_frames, which bounds latency: twice the target, or
+// the target plus one emulated frame and a quarter when that is larger
+// (short latencies hold less than a frame of audio). Writes are staged
+// until the emulated frame ends and then queued whole, or dropped whole
+// if they do not fit (faster than 1x, the ring fills every frame), so
+// the listener hears frame-sized skips rather than cuts mid-block.
+struct sdl_sink_state {
+    SDL_AudioDeviceID dev;
+    spsc_ring ring;
+    uint32_t target_frames;
+    uint32_t max_frames;
+    int16_t *staged;            // this emulated frame's audio, interleaved
+    size_t staged_frames;
+    size_t staged_capacity;     // in frames
+    bool started;
+    _Atomic uint64_t underruns;
+    _Atomic uint64_t overruns;      // read by pacing from the emulation thread
+};
+
+static void sdl_callback(void *userdata, Uint8 *stream, int len) {
+    struct sdl_sink_state *st = (struct sdl_sink_state *)userdata;
+    size_t want = (size_t)len / SINK_FRAME_BYTES;
+    size_t got = spsc_ring_read(st->ring, stream, want);
+
+    if (got < want) {
+        memset(stream + got * SINK_FRAME_BYTES, 0, (want - got) * SINK_FRAME_BYTES);
+        atomic_fetch_add_explicit(&st->underruns, 1u, memory_order_relaxed);
+    }
+}
+
+static void sdl_write(apu_sink s, const int16_t *frames, size_t frame_count) {
+    struct sdl_sink_state *st = (struct sdl_sink_state *)s->ctx;
+    if (st->staged_frames + frame_count > st->staged_capacity) {
+        size_t capacity = st->staged_capacity != 0u ? st->staged_capacity : 1024u;
+        while (capacity < st->staged_frames + frame_count) {
+            capacity *= 2u;
+        }
+        int16_t *staged = (int16_t *)realloc(st->staged, capacity * SINK_FRAME_BYTES);
+        if (staged == NULL) {
+            perror("[ERROR] Failed SDL audio staging allocation!");
+            exit(EXIT_FAILURE);
+        }
+        st->staged = staged;
+        st->staged_capacity = capacity;
+    }
+    memcpy(&st->staged[st->staged_frames * SINK_CHANNELS], frames, frame_count * SINK_FRAME_BYTES);
+    st->staged_frames += frame_count;
+}
+
+static void sdl_end_frame(apu_sink s) {
+    struct sdl_sink_state *st = (struct sdl_sink_state *)s->ctx;
+    uint32_t fill = spsc_ring_fill(st->ring);
+    size_t room = fill < st->max_frames ? st->max_frames - fill : 0u;
+
+    if (st->staged_frames > room) {
+        atomic_fetch_add_explicit(&st->overruns, 1u, memory_order_relaxed);
+    } else {
+        spsc_ring_write(st->ring, st->staged, st->staged_frames);
+    }
+    st->staged_frames = 0;
+
+    if (!st->started && spsc_ring_fill(st->ring) >= st->target_frames) {
+        st->started = true;
+        SDL_PauseAudioDevice(st->dev, 0);
+    }
+}
+
+static void sdl_stats(apu_sink s, struct apu_sink_stats *out) {
+    struct sdl_sink_state *st = (struct sdl_sink_state *)s->ctx;
+    out->queued_frames = spsc_ring_fill(st->ring);
+    out->target_frames = st->target_frames;
+    out->underruns = atomic_load_explicit(&st->underruns, memory_order_relaxed);
+    out->overruns = atomic_load_explicit(&st->overruns, memory_order_relaxed);
+}
+
+static void sdl_close(apu_sink s) {
+    struct sdl_sink_state *st = (struct sdl_sink_state *)s->ctx;
+    dbg_log("APU: SDL audio closed, %llu underruns, %llu overruns",
+            (unsigned long long)atomic_load(&st->underruns), (unsigned long long)atomic_load(&st->overruns));
+    SDL_CloseAudioDevice(st->dev);
+    spsc_ring_free(st->ring);
+    free(st->staged);
+    free(st);
+}
+
+apu_sink apu_sink_sdl(int sample_rate, int latency_ms) {
+    if ((SDL_WasInit(SDL_INIT_AUDIO) & SDL_INIT_AUDIO) == 0u) {
+        if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+            dbg_log("APU: SDL audio init failed: %s", SDL_GetError());
+            return NULL;
+        }
+    }
+
+    struct sdl_sink_state *st = (struct sdl_sink_state *)calloc(1, sizeof(*st));
+    if (st == NULL) {
+        perror("[ERROR] Failed SDL audio state allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    if (latency_ms < SDL_MIN_LATENCY_MS) latency_ms = SDL_MIN_LATENCY_MS;
+    if (latency_ms > SDL_MAX_LATENCY_MS) latency_ms = SDL_MAX_LATENCY_MS;
+    st->target_frames = (uint32_t)(sample_rate * latency_ms / 1000);
+    // A whole frame is queued on top of a ring held at the target, so
+    // leave room for one frame plus slack for rate control and rounding.
+    uint32_t frame_frames = (uint32_t)(((uint64_t)sample_rate * SDL_GB_FRAME_CYCLES +
+                                        SDL_GB_CPU_HZ - 1u) / SDL_GB_CPU_HZ);
+    st->max_frames = st->target_frames * 2u;
+    if (st->max_frames < st->target_frames + frame_frames + frame_frames / 4u) {
+        st->max_frames = st->target_frames + frame_frames + frame_frames / 4u;
+    }
+    st->ring = spsc_ring_new(st->max_frames, SINK_FRAME_BYTES);
+    atomic_init(&st->underruns, 0u);
+    atomic_init(&st->overruns, 0u);
+
+    // Device period: a power of two near a quarter of the target latency.
+    uint16_t period = 128u;
+    while (period < 4096u && (uint32_t)period * 8u <= st->target_frames) {
+        period = (uint16_t)(period * 2u);
+    }
+
+    SDL_AudioSpec want;
+    SDL_zero(want);
+    want.freq = sample_rate;
+    want.format = AUDIO_S16SYS;
+    want.channels = SINK_CHANNELS;
+    want.samples = period;
+    want.callback = sdl_callback;
+    want.userdata = st;
+
+    st->dev = SDL_OpenAudioDevice(NULL, 0, &want, NULL, 0);
+    if (st->dev == 0) {
+        dbg_log("APU: SDL_OpenAudioDevice failed: %s", SDL_GetError());
+        spsc_ring_free(st->ring);
+        free(st);
+        return NULL;
+    }
+
+    apu_sink s = sink_alloc(APU_SINK_SDL, sample_rate);
+    s->write = sdl_write;
+    s->end_frame = sdl_end_frame;
+    s->close = sdl_close;
+    s->stats = sdl_stats;
+    s->ctx = st;
+    dbg_log("APU: SDL audio %d ms target (%u frames, at most %u queued), device period %u",
+            latency_ms, st->target_frames, st->max_frames, (unsigned)period);
+    return s;
+}
+
+#else
+
+apu_sink apu_sink_sdl(int sample_rate, int latency_ms) {
+    (void)sample_rate;
+    (void)latency_ms;
+    fprintf(stderr, "[ERROR] SDL audio output needs the SDL build\n");
+    return NULL;
+}
+
+#endif
+
+apu_sink apu_sink_open(const char *spec, int sample_rate) {
+    apu_sink s = NULL;
+
+    if (spec == NULL || spec[0] == '\0') {
+#ifdef EASYGB_USE_SDL
+        spec = "sdl";
+#else
+        spec = "null";
+#endif
+    }
+
+    if (strcmp(spec, "null") == 0) {
+        return apu_sink_null();
+    } else if (strcmp(spec, "sdl") == 0) {
+        const char *latency = getenv("EASYGB_AUDIO_LATENCY");
+        int latency_ms = latency != NULL ? atoi(latency) : SDL_DEFAULT_LATENCY_MS;
+        s = apu_sink_sdl(sample_rate, latency_ms > 0 ? latency_ms : SDL_DEFAULT_LATENCY_MS);
+    } else if (strncmp(spec, "wav:", 4) == 0) {
+        s = apu_sink_wav(spec + 4, sample_rate);
+    } else if (strncmp(spec, "raw:", 4) == 0) {
+        s = apu_sink_raw(spec + 4, sample_rate);
+    } else {
+        fprintf(stderr, "[ERROR] Unknown audio output '%s'\n", spec);
+    }
+
+    if (s == NULL) {
+        dbg_log("APU: audio output '%s' unavailable, using null sink", spec);
+        return apu_sink_null();
+    }
+    dbg_log("APU: audio output '%s' at %d Hz", spec, sample_rate);
+    return s;
+}
+
+void apu_sink_write(apu_sink s, const int16_t *frames, size_t frame_count) {
+    s->write(s, frames, frame_count);
+    s->frames_written += frame_count;
+}
+
+void apu_sink_end_frame(apu_sink s) {
+    if (s->end_frame != NULL) {
+        s->end_frame(s);
+    }
+}
+
+bool apu_sink_get_stats(apu_sink s, struct apu_sink_stats *out) {
+    if (s->stats == NULL) {
+        return false;
+    }
+    s->stats(s, out);
+    return true;
+}
+
+void apu_sink_close(apu_sink s) {
+    if (s == NULL) {
+        return;
+    }
+    s->close(s);
+    free(s);
+}
@@ -0,0 +1,207 @@
+#include "include/blip.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+enum {
+    BLIP_FRAC_BITS = 32
+};
+
+// Kernel per quality tier: one row of taps for each sub-sample phase.
+// Every row sums to exactly BLIP_UNIT so the integrated output of a step
+// always settles on the step's height.
+struct blip_kernel {
+    const char *name;
+    const char *alias;
+    int taps;
+    int phase_bits;
+    double cutoff;              // relative to the output Nyquist rate
+    int16_t *table;
+};
+
+static struct blip_kernel blip_kernels[BLIP_QUALITY_COUNT] = {
+    [BLIP_QUALITY_LINEAR] = {"linear", "low", 2, 5, 0.0, NULL},
+    [BLIP_QUALITY_SINC16] = {"sinc16", "medium", 16, 5, 0.90, NULL},
+    [BLIP_QUALITY_SINC32] = {"sinc32", "high", 32, 6, 0.94, NULL}
+};
+
+static void normalize_row(const double *taps, int count, int16_t *row) {
+    double sum = 0.0;
+    for (int i = 0; i < count; i++) {
+        sum += taps[i];
+    }
+
+    int total = 0;
+    int peak = 0;
+    for (int i = 0; i < count; i++) {
+        int v = (int)lround(taps[i] * BLIP_UNIT / sum);
+        row[i] = (int16_t)v;
+        total += v;
+        if (taps[i] > taps[peak]) {
+            peak = i;
+        }
+    }
+    row[peak] = (int16_t)(row[peak] + (BLIP_UNIT - total));
+}
+
+// Linear splits each step between the two samples around it; the sinc
+// tiers use a Blackman-windowed sinc cut off a little below Nyquist.
+static void blip_build_kernel(struct blip_kernel *k) {
+    const double pi = 3.14159265358979323846;
+    int phases = 1 << k->phase_bits;
+    int half = k->taps / 2;
+
+    k->table = (int16_t *)calloc((size_t)phases * (size_t)k->taps, sizeof(int16_t));
+    if (k->table == NULL) {
+        perror("[ERROR] Failed blip kernel allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int p = 0; p < phases; p++) {
+        double frac = (double)p / phases;
+        double taps[BLIP_MAX_TAPS];
+
+        if (k->taps == 2) {
+            // Phase centres keep either tap below BLIP_UNIT (an int16 limit).
+            frac += 0.5 / phases;
+            taps[0] = 1.0 - frac;
+            taps[1] = frac;
+        } else {
+            for (int i = 0; i < k->taps; i++) {
+                double x = (double)(i - (half - 1)) - frac;
+                double cx = pi * k->cutoff * x;
+                double s = x == 0.0 ? 1.0 : sin(cx) / cx;
+                double w = 0.42 + 0.5 * cos(pi * x / half) + 0.08 * cos(2.0 * pi * x / half);
+                taps[i] = s * w;
+            }
+        }
+        normalize_row(taps, k->taps, &k->table[p * k->taps]);
+    }
+}
+
+blip_buffer blip_new(double clock_rate, double sample_rate, enum blip_quality quality) {
+    blip_buffer b = (blip_buffer)calloc(1, sizeof(struct BlipBuffer));
+    if (b == NULL) {
+        perror("[ERROR] Failed blip buffer allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    if ((unsigned)quality >= BLIP_QUALITY_COUNT) {
+        quality = BLIP_QUALITY_SINC16;
+    }
+    struct blip_kernel *k = &blip_kernels[quality];
+    if (k->table == NULL) {
+        blip_build_kernel(k);
+    }
+    b->kernel = k->table;
+    b->taps = k->taps;
+    b->phase_shift = BLIP_FRAC_BITS - k->phase_bits;
+
+    blip_set_rates(b, clock_rate, sample_rate);
+    return b;
+}
+
+void blip_free(blip_buffer b) {
+    free(b);
+}
+
+void blip_set_rates(blip_buffer b, double clock_rate, double sample_rate) {
+    b->factor = (uint64_t)(sample_rate / clock_rate * (double)((uint64_t)1 << BLIP_FRAC_BITS) + 0.5);
+}
+
+void blip_clear(blip_buffer b) {
+    b->offset = 0u;
+    b->integrator = 0;
+    b->avail = 0;
+    memset(b->buf, 0, sizeof(b->buf));
+}
+
+#if defined(__SSE2__)
+// Eight taps per pass: 16x16 products widened to 32 bits from mullo/mulhi.
+static inline void add_taps_sse2(int32_t *out, const int16_t *k, int taps, int16_t delta) {
+    __m128i d = _mm_set1_epi16(delta);
+    for (int i = 0; i < taps; i += 8) {
+        __m128i kv = _mm_loadu_si128((const __m128i *)(k + i));
+        __m128i lo = _mm_mullo_epi16(kv, d);
+        __m128i hi = _mm_mulhi_epi16(kv, d);
+        __m128i *o0 = (__m128i *)(out + i);
+        __m128i *o1 = (__m128i *)(out + i + 4);
+        _mm_storeu_si128(o0, _mm_add_epi32(_mm_loadu_si128(o0), _mm_unpacklo_epi16(lo, hi)));
+        _mm_storeu_si128(o1, _mm_add_epi32(_mm_loadu_si128(o1), _mm_unpackhi_epi16(lo, hi)));
+    }
+}
+#endif
+
+void blip_add_delta(blip_buffer b, uint32_t time, int delta) {
+    uint64_t pos = b->offset + (uint64_t)time * b->factor;
+    uint32_t idx = (uint32_t)(pos >> BLIP_FRAC_BITS);
+    uint32_t phase = (uint32_t)((pos & 0xFFFFFFFFu) >> b->phase_shift);
+    if (idx >= BLIP_CAPACITY) {
+        return;     // caller overran the frame; drop rather than corrupt
+    }
+
+    const int16_t *k = &b->kernel[phase * (uint32_t)b->taps];
+    int32_t *out = &b->buf[idx];
+#if defined(__SSE2__)
+    if ((b->taps & 7) == 0 && delta >= INT16_MIN && delta <= INT16_MAX) {
+        add_taps_sse2(out, k, b->taps, (int16_t)delta);
+        return;
+    }
+#endif
+    for (int i = 0; i < b->taps; i++) {
+        out[i] += (int32_t)k[i] * delta;
+    }
+}
+
+void blip_end_frame(blip_buffer b, uint32_t clocks) {
+    b->offset += (uint64_t)clocks * b->factor;
+    b->avail = (int)(b->offset >> BLIP_FRAC_BITS);
+    if (b->avail > BLIP_CAPACITY) {
+        b->avail = BLIP_CAPACITY;
+    }
+}
+
+int blip_read_samples(blip_buffer b, int32_t *out, int count) {
+    if (count > b->avail) {
+        count = b->avail;
+    }
+
+    int32_t sum = b->integrator;
+    for (int i = 0; i < count; i++) {
+        sum += b->buf[i];
+        out[i] = sum;
+    }
+    b->integrator = sum;
+
+    // Shift the unread samples and the pending kernel tails down.
+    int remain = b->avail - count + BLIP_MAX_TAPS;
+    memmove(b->buf, &b->buf[count], (size_t)remain * sizeof(b->buf[0]));
+    memset(&b->buf[remain], 0, (size_t)count * sizeof(b->buf[0]));
+    b->offset -= (uint64_t)count << BLIP_FRAC_BITS;
+    b->avail -= count;
+    return count;
+}
+
+const char *blip_quality_name(enum blip_quality quality) {
+    if ((unsigned)quality >= BLIP_QUALITY_COUNT) {
+        return "?";
+    }
+    return blip_kernels[quality].name;
+}
+
+// Accepts the tier names and low/medium/high.
+bool blip_quality_parse(const char *name, enum blip_quality *out) {
+    for (int q = 0; q < BLIP_QUALITY_COUNT; q++) {
+        if (strcmp(name, blip_kernels[q].name) == 0 || strcmp(name, blip_kernels[q].alias) == 0) {
+            *out = (enum blip_quality)q;
+            return true;
+        }
+    }
+    return false;
+}
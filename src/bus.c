@@ -1,5 +1,6 @@
 #include "include/bus.h"
 #include "include/debug.h"
+#include "include/prof.h"
 #include <ctype.h>
 
 struct Bus_internal {
@@ -14,6 +15,7 @@ struct Bus_internal {
     uint8_t oam[160];
     uint8_t io[0x80];
     uint32_t io_write_serial[0x80];
+    uint32_t oam_write_serial;
     uint8_t ie;
     uint8_t joypad_pressed;
 
@@ -35,8 +37,29 @@ struct Bus_internal {
     uint16_t div_counter;
     uint16_t tima_counter;
     uint16_t ppu_counter;
+
+    // Master clock (T-cycles retired so far) and the lazily-run PPU: it is
+    // brought up to date before any access to VRAM, OAM or FF40-FF4B, and
+    // from bus_tick once the clock reaches the deadline it last reported.
+    uint64_t cycles;
+    uint64_t ppu_deadline;
+    bus_sync_fn ppu_sync;
+    void *ppu_sync_ctx;
+
+    // Sound registers and wave RAM (FF10-FF3F) belong to the APU once it
+    // registers; io[] no longer holds them then.
+    bus_io_read_fn apu_read;
+    bus_io_write_fn apu_write;
+    void *apu_ctx;
+
+    bus_serial_fn serial_out;
+    void *serial_ctx;
 };
 
+#ifdef EASYGB_PROFILE
+volatile sig_atomic_t prof_zone = PROF_CPU;
+#endif
+
 #ifdef DEBUGLOG
 static const char *bus_region_name(uint16_t addr) {
     if (addr <= 0x7FFF) return "ROM";
@@ -138,6 +161,20 @@ static inline void joyp_request_irq_on_falling_edge(bus b, uint8_t old_joyp, uin
     }
 }
 
+static inline bool is_apu_io(bus b, uint16_t addr) {
+    return addr >= 0xFF10u && addr <= 0xFF3Fu && b->mem->apu_read != NULL;
+}
+
+static inline bool is_ppu_io(uint16_t addr) {
+    return addr >= 0xFF40u && addr <= 0xFF4Bu;
+}
+
+static inline void sync_ppu(bus b) {
+    if (b->mem->ppu_sync != NULL) {
+        b->mem->ppu_sync(b->mem->ppu_sync_ctx);
+    }
+}
+
 static inline bool is_mbc1(int mapper_type) {
     return mapper_type == 0x01 || mapper_type == 0x02 || mapper_type == 0x03;
 }
@@ -273,6 +310,7 @@ static void handle_special_io_write(bus b, uint16_t addr, uint8_t val) {
         for (uint16_t i = 0; i < 0x00A0u; i++) {
             b->mem->oam[i] = bus_read8(b, (uint16_t)(src + i));
         }
+        b->mem->oam_write_serial++;
     }
 
     // Serial output (SB/SC): used by many test ROMs (e.g. blargg).
@@ -283,6 +321,9 @@ static void handle_special_io_write(bus b, uint16_t addr, uint8_t val) {
         fflush(stdout);
         dbg_log("SERIAL TX: 0x%02X '%c'", ch,
                 isprint((int)ch) ? (char)ch : '.');
+        if (b->mem->serial_out != NULL) {
+            b->mem->serial_out(b->mem->serial_ctx, ch);
+        }
 
         // Transfer complete: clear start bit, keep clock select.
         b->mem->io[0x02] = 0x01;
@@ -363,7 +404,7 @@ void snapshot_bus(bus b) {
     fclose(f);
 }
 
-bus bus_init(cartridge cart) {
+static bus bus_create(cartridge cart, bool allow_boot_rom) {
     bus rbus = malloc(sizeof(struct Bus));
     if (!rbus) {
         perror("[ERROR] Failed allocation of bus structure!");
@@ -378,7 +419,12 @@ bus bus_init(cartridge cart) {
 
     // bind cartridge
     rbus->mem->rom = cart;
-    maybe_init_boot_rom(rbus);
+    if (allow_boot_rom) {
+        maybe_init_boot_rom(rbus);
+    } else {
+        rbus->mem->boot_rom_loaded = false;
+        rbus->mem->boot_rom_enabled = false;
+    }
 
     // Init Cart RAM
     size_t ram_bytes = KIB(cart->head->ram_size);
@@ -400,6 +446,7 @@ bus bus_init(cartridge cart) {
     memset(rbus->mem->hram, 0x00, 127);
     memset(rbus->mem->io,   0x00, 0x80);
     memset(rbus->mem->io_write_serial, 0x00, sizeof(rbus->mem->io_write_serial));
+    rbus->mem->oam_write_serial = 0;
 
     // --- Default mapper state ---
     rbus->mem->mapper_type = cart->head->cart_type;
@@ -495,6 +542,15 @@ bus bus_init(cartridge cart) {
     rbus->mem->div_counter = 0;
     rbus->mem->tima_counter = 0;
     rbus->mem->ppu_counter = 0;
+    rbus->mem->cycles = 0;
+    rbus->mem->ppu_deadline = UINT64_MAX;
+    rbus->mem->ppu_sync = NULL;
+    rbus->mem->ppu_sync_ctx = NULL;
+    rbus->mem->apu_read = NULL;
+    rbus->mem->apu_write = NULL;
+    rbus->mem->apu_ctx = NULL;
+    rbus->mem->serial_out = NULL;
+    rbus->mem->serial_ctx = NULL;
 
     // Function pointers (the bus logic)
     // li inizializzi tu altrove
@@ -506,6 +562,26 @@ bus bus_init(cartridge cart) {
     return rbus;
 }
 
+bus bus_init(cartridge cart) {
+    return bus_create(cart, true);
+}
+
+// Skips the boot ROM even when one is available: for images that are not
+// cartridges (the GBS player's), which it would refuse to start.
+bus bus_init_post_boot(cartridge cart) {
+    return bus_create(cart, false);
+}
+
+// Frees the bus and cartridge RAM; the cartridge stays with the caller.
+void bus_destroy(bus b) {
+    if (b == NULL) {
+        return;
+    }
+    free(b->mem->cart_ram);
+    free(b->mem);
+    free(b);
+}
+
 uint8_t bus_read8(bus b, uint16_t addr) {
     if (b->mem->boot_rom_enabled && addr < 0x0100u) {
         uint8_t v = b->mem->boot_rom[addr];
@@ -544,6 +620,7 @@ uint8_t bus_read8(bus b, uint16_t addr) {
 
     // 8000–9FFF: VRAM
     if (addr <= 0x9FFF) {
+        sync_ppu(b);
         uint8_t v = b->mem->vram[addr - 0x8000];
         BUS_LOG_R8(addr, v);
         return v;
@@ -591,6 +668,7 @@ uint8_t bus_read8(bus b, uint16_t addr) {
 
     // FE00–FE9F: OAM
     if (addr <= 0xFE9F) {
+        sync_ppu(b);
         uint8_t v = b->mem->oam[addr - 0xFE00];
         BUS_LOG_R8(addr, v);
         return v;
@@ -604,6 +682,14 @@ uint8_t bus_read8(bus b, uint16_t addr) {
 
     // FF00–FF7F: IO registers
     if (addr <= 0xFF7F) {
+        if (is_apu_io(b, addr)) {
+            uint8_t v = b->mem->apu_read(b->mem->apu_ctx, addr);
+            BUS_LOG_R8(addr, v);
+            return v;
+        }
+        if (is_ppu_io(addr)) {
+            sync_ppu(b);
+        }
         uint8_t v = b->mem->io[addr - 0xFF00];
         if (addr == 0xFF00) {
             v = joyp_compute(b);
@@ -637,6 +723,7 @@ void bus_write8(bus b, uint16_t addr, uint8_t val) {
 
     // 8000–9FFF: VRAM
     if (addr <= 0x9FFF) {
+        sync_ppu(b);
         b->mem->vram[addr - 0x8000] = val;
         BUS_LOG_W8(addr, val);
         return;
@@ -678,7 +765,9 @@ void bus_write8(bus b, uint16_t addr, uint8_t val) {
 
     // FE00–FE9F: OAM
     if (addr <= 0xFE9F) {
+        sync_ppu(b);
         b->mem->oam[addr - 0xFE00] = val;
+        b->mem->oam_write_serial++;
         BUS_LOG_W8(addr, val);
         return;
     }
@@ -702,9 +791,21 @@ void bus_write8(bus b, uint16_t addr, uint8_t val) {
             return;
         }
 
+        if (is_apu_io(b, addr)) {
+            b->mem->apu_write(b->mem->apu_ctx, addr, val);
+            BUS_LOG_W8(addr, val);
+            return;
+        }
+
         if (addr == 0xFF0F) {
             val = (uint8_t)((val & 0x1Fu) | 0xE0u);
         }
+        if (is_ppu_io(addr)) {
+            // Catch up under the old value, then have the PPU look at the
+            // new one at the end of this instruction.
+            sync_ppu(b);
+            b->mem->ppu_deadline = 0;
+        }
         b->mem->io[addr - 0xFF00] = val;
         handle_special_io_write(b, addr, val);
         b->mem->io_write_serial[addr - 0xFF00]++;
@@ -738,11 +839,6 @@ void bus_write16(bus b, uint16_t addr, uint16_t val) {
     bus_write8(b, addr + 1, high);
 }
 
-void bus_set_ly(bus b, uint8_t ly) {
-    b->mem->io[0x44] = ly;
-    BUS_LOG_W8(0xFF44, ly);
-}
-
 void bus_set_joypad_state(bus b, uint8_t pressed_mask) {
     if (b == NULL || b->mem == NULL) {
         return;
@@ -768,6 +864,48 @@ uint32_t bus_get_io_write_serial(bus b, uint16_t addr) {
     return b->mem->io_write_serial[addr - 0xFF00u];
 }
 
+uint32_t bus_get_oam_write_serial(bus b) {
+    return b->mem->oam_write_serial;
+}
+
+const uint8_t *bus_get_vram(bus b) {
+    return b->mem->vram;
+}
+
+const uint8_t *bus_get_oam(bus b) {
+    return b->mem->oam;
+}
+
+// Raw FF00-FF7F for the PPU, which owns LY/STAT and raises IF bits itself.
+// Stores through it skip handle_special_io_write and the write serials.
+uint8_t *bus_get_io(bus b) {
+    return b->mem->io;
+}
+
+uint64_t bus_get_cycles(bus b) {
+    return b->mem->cycles;
+}
+
+void bus_set_ppu_sync(bus b, bus_sync_fn sync, void *ctx) {
+    b->mem->ppu_sync = sync;
+    b->mem->ppu_sync_ctx = ctx;
+}
+
+void bus_set_ppu_deadline(bus b, uint64_t cycle) {
+    b->mem->ppu_deadline = cycle;
+}
+
+void bus_set_apu_io(bus b, bus_io_read_fn read, bus_io_write_fn write, void *ctx) {
+    b->mem->apu_read = read;
+    b->mem->apu_write = write;
+    b->mem->apu_ctx = ctx;
+}
+
+void bus_set_serial_out(bus b, bus_serial_fn out, void *ctx) {
+    b->mem->serial_out = out;
+    b->mem->serial_ctx = ctx;
+}
+
 static inline uint16_t timer_period_cycles(uint8_t tac) {
     switch (tac & 0x03u) {
     case 0x00: return 1024; // 4096 Hz
@@ -782,6 +920,12 @@ void bus_tick(bus b, int cycles) {
         return;
     }
 
+    b->mem->cycles += (uint64_t)cycles;
+    if (b->mem->cycles >= b->mem->ppu_deadline) {
+        sync_ppu(b);
+    }
+    PROF_ENTER(PROF_TIMER);
+
     b->mem->div_counter = (uint16_t)(b->mem->div_counter + (uint16_t)cycles);
     while (b->mem->div_counter >= 256u) {
         b->mem->div_counter = (uint16_t)(b->mem->div_counter - 256u);
@@ -790,6 +934,7 @@ void bus_tick(bus b, int cycles) {
 
     uint8_t tac = b->mem->io[0x07];
     if ((tac & 0x04u) == 0u) {
+        PROF_LEAVE();
         return;
     }
 
@@ -806,5 +951,6 @@ void bus_tick(bus b, int cycles) {
             b->mem->io[0x05] = (uint8_t)(b->mem->io[0x05] + 1u);
         }
     }
+    PROF_LEAVE();
 }
    
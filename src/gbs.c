@@ -0,0 +1,224 @@
+#include "include/gbs.h"
+#include "include/apu.h"
+#include "include/bus.h"
+#include "include/cpu.h"
+#include "include/debug.h"
+
+#include <time.h>
+
+enum {
+    GBS_HEADER_SIZE = 0x70,
+    GBS_VERSION = 1,
+    GBS_MIN_LOAD_ADDR = 0x0400,     // below is the player's, per the format
+    GBS_STUB_ADDR = 0x0070,         // after the interrupt vectors
+    GBS_CART_TYPE = 0x13,           // MBC3+RAM: 7-bit bank register, 2 MiB
+    GBS_MAX_ROM_KIB = 2048,
+    GBS_RAM_KIB = 8,
+    GBS_CPU_HZ = 4194304,
+    GBS_FRAME_CYCLES = 70224        // VBlank-driven songs play once per frame
+};
+
+static inline uint16_t le16(const uint8_t *p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static void copy_field(char *dst, const uint8_t *src) {
+    memcpy(dst, src, 32);
+    dst[32] = '\0';
+}
+
+static inline void put16(uint8_t *rom, uint16_t at, uint16_t val) {
+    rom[at] = (uint8_t)(val & 0xFFu);
+    rom[at + 1] = (uint8_t)(val >> 8);
+}
+
+// Low ROM as a GBS player sets it up: RST n jumps to load_addr + n, the
+// VBlank and timer vectors call play, and the entry stub calls init with
+// the song in A and then sleeps in HALT between interrupts.
+static void gbs_write_stub(uint8_t *rom, const struct GBSFile *g) {
+    for (uint16_t n = 0; n < 0x40u; n = (uint16_t)(n + 8u)) {
+        rom[n] = 0xC3;                                  // JP load+n
+        put16(rom, (uint16_t)(n + 1u), (uint16_t)(g->load_addr + n));
+    }
+    for (uint16_t v = 0x40; v <= 0x60u; v = (uint16_t)(v + 8u)) {
+        rom[v] = 0xD9;                                  // RETI
+    }
+    static const uint16_t play_vectors[] = {0x40, 0x50};
+    for (size_t i = 0; i < sizeof(play_vectors) / sizeof(play_vectors[0]); i++) {
+        uint16_t v = play_vectors[i];
+        rom[v] = 0xCD;                                  // CALL play
+        put16(rom, (uint16_t)(v + 1u), g->play_addr);
+        rom[v + 3] = 0xD9;                              // RETI
+    }
+
+    uint16_t at = GBS_STUB_ADDR;
+    rom[at] = 0xCD;                                     // CALL init
+    put16(rom, (uint16_t)(at + 1u), g->init_addr);
+    rom[at + 3] = 0xFB;                                 // EI
+    rom[at + 4] = 0x76;                                 // HALT
+    rom[at + 5] = 0x18;                                 // JR -3 (HALT)
+    rom[at + 6] = 0xFD;
+}
+
+static cartridge gbs_build_cart(const struct GBSFile *g, const uint8_t *data, size_t size,
+                                uint32_t rom_kib) {
+    cartridge cart = (cartridge)malloc(sizeof(struct cartridge));
+    header head = (header)calloc(1, sizeof(struct header));
+    uint8_t *rom = (uint8_t *)calloc(KIB((size_t)rom_kib), 1);
+    if (cart == NULL || head == NULL || rom == NULL) {
+        perror("[ERROR] Error allocating GBS image!");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(&rom[g->load_addr], data, size);
+    gbs_write_stub(rom, g);
+
+    memcpy(head->title, g->title, sizeof(head->title) - 1u);
+    head->cart_type = GBS_CART_TYPE;
+    head->rom_size = rom_kib;
+    head->ram_size = GBS_RAM_KIB;
+
+    cart->raw_cart = rom;
+    cart->head = head;
+    return cart;
+}
+
+gbs_file gbs_load(const char *path) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror("[ERROR] Error reading GBS file!");
+        return NULL;
+    }
+
+    fseek(f, 0L, SEEK_END);
+    long file_size = ftell(f);
+    rewind(f);
+    if (file_size <= GBS_HEADER_SIZE) {
+        fprintf(stderr, "[ERROR] %s is too short for a GBS file\n", path);
+        fclose(f);
+        return NULL;
+    }
+
+    uint8_t *buf = (uint8_t *)malloc((size_t)file_size);
+    if (buf == NULL) {
+        perror("[ERROR] Error allocating GBS file!");
+        exit(EXIT_FAILURE);
+    }
+    size_t read_bytes = fread(buf, 1, (size_t)file_size, f);
+    fclose(f);
+    if (read_bytes != (size_t)file_size) {
+        perror("[ERROR] GBS file truncated!");
+        free(buf);
+        return NULL;
+    }
+
+    if (memcmp(buf, "GBS", 3) != 0 || buf[3] != GBS_VERSION) {
+        fprintf(stderr, "[ERROR] %s is not a GBS v1 file\n", path);
+        free(buf);
+        return NULL;
+    }
+
+    gbs_file g = (gbs_file)calloc(1, sizeof(struct GBSFile));
+    if (g == NULL) {
+        perror("[ERROR] Error allocating GBS file!");
+        exit(EXIT_FAILURE);
+    }
+    g->song_count = buf[0x04];
+    g->first_song = buf[0x05];
+    g->load_addr = le16(&buf[0x06]);
+    g->init_addr = le16(&buf[0x08]);
+    g->play_addr = le16(&buf[0x0A]);
+    g->stack_ptr = le16(&buf[0x0C]);
+    g->tma = buf[0x0E];
+    g->tac = buf[0x0F];
+    copy_field(g->title, &buf[0x10]);
+    copy_field(g->author, &buf[0x30]);
+    copy_field(g->copyright, &buf[0x50]);
+
+    size_t data_size = (size_t)file_size - GBS_HEADER_SIZE;
+    size_t image_size = (size_t)g->load_addr + data_size;
+    uint32_t rom_kib = 32;
+    while (rom_kib < GBS_MAX_ROM_KIB && KIB((size_t)rom_kib) < image_size) {
+        rom_kib *= 2u;
+    }
+
+    if (g->song_count == 0 || g->load_addr < GBS_MIN_LOAD_ADDR || g->load_addr > 0x7FFFu ||
+        image_size > KIB((size_t)rom_kib)) {
+        fprintf(stderr, "[ERROR] %s: unsupported GBS layout (load %04X, %zu bytes, %u songs)\n",
+                path, g->load_addr, data_size, g->song_count);
+        free(buf);
+        free(g);
+        return NULL;
+    }
+    if (g->first_song == 0 || g->first_song > g->song_count) {
+        g->first_song = 1;
+    }
+    if ((g->tac & 0x80u) != 0u) {
+        dbg_log("GBS: CGB double-speed timer requested, playing at single speed");
+    }
+
+    g->cart = gbs_build_cart(g, &buf[GBS_HEADER_SIZE], data_size, rom_kib);
+    free(buf);
+    dbg_log("GBS loaded: '%s' load=%04X init=%04X play=%04X sp=%04X tma=%02X tac=%02X songs=%u",
+            g->title, g->load_addr, g->init_addr, g->play_addr, g->stack_ptr, g->tma, g->tac,
+            g->song_count);
+    return g;
+}
+
+void gbs_free(gbs_file g) {
+    if (g == NULL) {
+        return;
+    }
+    free(g->cart->raw_cart);
+    free(g->cart->head);
+    free(g->cart);
+    free(g);
+}
+
+static double wall_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+double gbs_render_song(gbs_file g, int song, double seconds, const char *sink_spec) {
+    bus b = bus_init_post_boot(g->cart);
+    cpu c = cpu_init(b);
+    apu a = apu_init_with_spec(b, sink_spec);
+    bool on_timer = (g->tac & 0x04u) != 0u;
+
+    // No PPU in this mode: LCD off, and the VBlank request comes from here.
+    bus_get_io(b)[0x40] = 0x00;
+    bus_write8(b, 0x0000, 0x0A);                        // cartridge RAM on
+    bus_write8(b, 0xFF05, g->tma);
+    bus_write8(b, 0xFF06, g->tma);
+    bus_write8(b, 0xFF07, (uint8_t)(g->tac & 0x07u));
+    bus_write8(b, 0xFF0F, 0x00);
+    bus_write8(b, 0xFFFF, on_timer ? 0x04u : 0x01u);
+
+    c->A = (uint8_t)song;
+    c->SP = g->stack_ptr;
+    c->PC = GBS_STUB_ADDR;
+    c->ime = false;
+
+    uint64_t end = (uint64_t)(seconds * GBS_CPU_HZ);
+    uint64_t next_frame = GBS_FRAME_CYCLES;
+    double start = wall_seconds();
+
+    while (bus_get_cycles(b) < end) {
+        cpu_step(c);
+        if (bus_get_cycles(b) >= next_frame) {
+            next_frame += GBS_FRAME_CYCLES;
+            if (!on_timer) {
+                bus_get_io(b)[0x0F] |= 0x01u;
+            }
+            apu_end_frame(a);
+        }
+    }
+
+    double elapsed = wall_seconds() - start;
+    apu_destroy(a);
+    free(c);
+    bus_destroy(b);
+    return elapsed;
+}
@@ -3,12 +3,37 @@
 
 #include <stdint.h>
 
+#include "apu_log.h"
+#include "apu_sink.h"
 #include "bus.h"
 
 typedef struct APU* apu;
 
+// apu_init picks its output from EASYGB_AUDIO (see apu_sink_open);
+// apu_init_with_spec takes the same kind of spec directly.
 apu  apu_init(bus b);
+apu  apu_init_with_spec(bus b, const char *spec);
+apu  apu_init_with_sink(bus b, apu_sink sink);
 void apu_destroy(apu a);
-void apu_step(apu a, int cpu_cycles);
+
+// The APU runs lazily off the bus clock, catching up whenever the CPU
+// touches FF10-FF3F. apu_end_frame brings it current and hands the
+// finished samples to the sink; call it once per emulated frame.
+// With EASYGB_AUDIO_THREAD=1 the sink is fed from an audio thread that
+// replays a log of the register writes, one frame behind.
+void apu_end_frame(apu a);
+
+// EASYGB_APU_LOG=PATH records every write to FF10-FF3F and every frame
+// end (see apu_log.h). apu_init_detached starts an APU without a bus from
+// a log's header, and apu_replay feeds it the log's entries; with the same
+// EASYGB_AUDIO_RATE/QUALITY the output matches the recording run sample
+// for sample.
+apu  apu_init_detached(const char *spec, const uint8_t *regs, uint64_t cycle);
+void apu_replay(apu a, const struct apu_log_entry *e);
+
+#define APU_MAX_RATE_ADJUST 0.005
+
+apu_sink apu_get_sink(apu a);
+void apu_set_rate_adjust(apu a, double ratio);
 
 #endif
@@ -0,0 +1,54 @@
+#ifndef APU_LOG_H
+#define APU_LOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+enum {
+    APU_LOG_REG_BASE = 0xFF10,
+    APU_LOG_REG_COUNT = 0x30    // FF10-FF3F: NR10-NR52 and wave RAM
+};
+
+// Everything the APU takes from outside, stamped with the bus clock. The
+// audio thread is fed these through a ring, and log files store them.
+enum apu_log_kind {
+    APU_LOG_WRITE,              // CPU wrote value to addr
+    APU_LOG_END_FRAME,          // apu_end_frame
+    APU_LOG_RATE                // apu_set_rate_adjust(ratio)
+};
+
+struct apu_log_entry {
+    uint64_t cycle;
+    double   ratio;
+    uint16_t addr;
+    uint8_t  value;
+    uint8_t  kind;
+};
+
+typedef struct APULogFile* apu_log_file;
+
+// Log file layout: "EGBAPU", version, a zero byte, the start cycle (u64
+// LE) and FF10-FF3F at that cycle; then per entry the cycle delta as a
+// LEB128 varint followed by a register index (0x00-0x2F) and value, 0xFF
+// for a frame end, or 0xFE and the ratio as an IEEE double (u64 LE) for
+// an output rate change. A busy frame takes a few hundred bytes.
+//
+// Rate changes (EASYGB_PACING=audio) alter the output samples, so they
+// are stored and replayed with the rest; version 1 logs, from before they
+// were, still open. The ratio is kept, not the host timing that chose it,
+// so a replay matches the recorded samples but not a new live run.
+struct APULogFile {
+    FILE *f;
+    uint64_t last_cycle;
+};
+
+apu_log_file apu_log_create(const char *path, uint64_t start_cycle, const uint8_t *regs);
+// Returns NULL (after printing why) if path is missing or not a log.
+apu_log_file apu_log_open(const char *path, uint64_t *start_cycle, uint8_t *regs);
+void apu_log_append(apu_log_file l, const struct apu_log_entry *e);
+// False at the end of the log.
+bool apu_log_next(apu_log_file l, struct apu_log_entry *e);
+void apu_log_close(apu_log_file l);
+
+#endif
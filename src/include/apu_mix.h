@@ -0,0 +1,38 @@
+#ifndef APU_MIX_H
+#define APU_MIX_H
+
+#include <stdint.h>
+
+enum {
+    APU_MIX_CHANNELS = 4,
+    APU_MIX_MAX_BLOCK = 512     // samples per apu_mix_block call
+};
+
+// NR50/NR51 folded into one Q12 gain per channel and side (0 = not routed).
+// Rebuilt only when either register is written.
+struct apu_mix_gains {
+    int16_t left[APU_MIX_CHANNELS];
+    int16_t right[APU_MIX_CHANNELS];
+};
+
+// DC-blocking high-pass state, Q12 samples.
+struct apu_hpf {
+    int32_t coeff;              // pole, Q16
+    int32_t prev_in[2];
+    int32_t prev_out[2];
+};
+
+void apu_mix_set_gains(struct apu_mix_gains *g, uint8_t nr50, uint8_t nr51);
+
+// Clears the filter and sets its ~30 Hz corner for sample_rate.
+void apu_hpf_init(struct apu_hpf *h, int sample_rate);
+
+// Routes, scales and high-passes count samples of the four channel blocks
+// (step-buffer levels, BLIP_UNIT per 1/15 of full scale) into interleaved
+// s16 stereo. Uses AVX2 or SSE2 when available.
+void apu_mix_block(const struct apu_mix_gains *g, struct apu_hpf *hpf,
+                   const int32_t *const chan[APU_MIX_CHANNELS], int16_t *out, int count);
+
+const char *apu_mix_kernel_name(void);
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef APU_SINK_H
+#define APU_SINK_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+enum apu_sink_kind {
+    APU_SINK_NULL,      // register semantics only, no mixing
+    APU_SINK_WAV,
+    APU_SINK_RAW,       // headerless interleaved s16 stereo
+    APU_SINK_SDL
+};
+
+typedef struct APUSink* apu_sink;
+
+// Queue state of sinks that buffer ahead of a real-time consumer.
+struct apu_sink_stats {
+    uint32_t queued_frames;
+    uint32_t target_frames;
+    uint64_t underruns;         // consumer found the queue empty
+    uint64_t overruns;          // emulated frames whose audio was dropped on a full queue
+};
+
+// Where mixed audio goes. Frames are interleaved signed 16-bit stereo at
+// the sink's sample rate.
+struct APUSink {
+    enum apu_sink_kind kind;
+    int      sample_rate;
+    bool     wants_samples;     // false: the APU skips channel timers and mixing
+    uint64_t frames_written;
+
+    void (*write)(apu_sink s, const int16_t *frames, size_t frame_count);
+    void (*end_frame)(apu_sink s);                              // NULL: nothing to do
+    void (*close)(apu_sink s);
+    void (*stats)(apu_sink s, struct apu_sink_stats *out);     // NULL: no queue
+    void *ctx;
+};
+
+apu_sink apu_sink_null(void);
+apu_sink apu_sink_wav(const char *path, int sample_rate);
+apu_sink apu_sink_raw(const char *path, int sample_rate);
+// Pulls from a lock-free ring through the SDL audio callback, holding
+// about latency_ms of audio (EASYGB_AUDIO_LATENCY via apu_sink_open).
+// At most the larger of twice that or that plus about one emulated
+// frame's audio is ever queued.
+// Audio is queued one emulated frame at a time: a frame that does not fit
+// in the ring (e.g. faster than 1x) is dropped whole, never cut short.
+apu_sink apu_sink_sdl(int sample_rate, int latency_ms);
+
+// Opens a sink from a spec: "null", "sdl", "wav:PATH" or "raw:PATH".
+// NULL or an empty spec picks SDL in windowed builds and null otherwise.
+// A sink that cannot be opened falls back to null.
+apu_sink apu_sink_open(const char *spec, int sample_rate);
+
+void apu_sink_write(apu_sink s, const int16_t *frames, size_t frame_count);
+// Marks the end of an emulated frame's audio (after apu_end_frame).
+void apu_sink_end_frame(apu_sink s);
+bool apu_sink_get_stats(apu_sink s, struct apu_sink_stats *out);
+void apu_sink_close(apu_sink s);
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Band-limited step buffer: a channel reports each change of its output
+// level as a delta at a clock time, and whole blocks of output samples are
+// synthesized from those deltas on demand. The kernel that spreads each
+// step over neighbouring samples is the resampler from the source clock to
+// the output rate; the quality tier picks it.
+enum blip_quality {
+    BLIP_QUALITY_LINEAR,        // 2-tap linear step: cheapest, some aliasing
+    BLIP_QUALITY_SINC16,        // 16-tap windowed sinc, 32 phases (default)
+    BLIP_QUALITY_SINC32,        // 32-tap windowed sinc, 64 phases
+    BLIP_QUALITY_COUNT
+};
+
+enum {
+    BLIP_MAX_TAPS = 32,
+    BLIP_CAPACITY = 4096,       // output samples one frame may span
+    BLIP_UNIT = 32768           // sum of each kernel phase: a delta of 1
+};
+
+typedef struct BlipBuffer* blip_buffer;
+
+struct BlipBuffer {
+    uint64_t factor;    // output samples per clock, 32.32 fixed point
+    uint64_t offset;    // 32.32 position of clock 0 of the current frame
+    int32_t  integrator;
+    int      avail;     // samples complete and ready to read
+
+    const int16_t *kernel;      // [phases][taps]
+    int      taps;
+    int      phase_shift;       // 32.32 position -> phase index
+
+    int32_t  buf[BLIP_CAPACITY + BLIP_MAX_TAPS];
+};
+
+blip_buffer blip_new(double clock_rate, double sample_rate, enum blip_quality quality);
+void blip_free(blip_buffer b);
+void blip_set_rates(blip_buffer b, double clock_rate, double sample_rate);
+void blip_clear(blip_buffer b);
+
+void blip_add_delta(blip_buffer b, uint32_t time, int delta);
+void blip_end_frame(blip_buffer b, uint32_t clocks);
+
+// Reads up to count samples (levels scaled by BLIP_UNIT); returns how many.
+int  blip_read_samples(blip_buffer b, int32_t *out, int count);
+
+const char *blip_quality_name(enum blip_quality quality);
+bool blip_quality_parse(const char *name, enum blip_quality *out);
+
+#endif
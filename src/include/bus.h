@@ -29,6 +29,15 @@ struct Bus {
 
 typedef struct Bus* bus;
 
+// Called by the bus before it touches state owned by a lazily-run component.
+typedef void (*bus_sync_fn)(void *ctx);
+
+// Handlers for an IO range a component owns outright (the APU's FF10-FF3F).
+typedef uint8_t (*bus_io_read_fn)(void *ctx, uint16_t addr);
+typedef void    (*bus_io_write_fn)(void *ctx, uint16_t addr, uint8_t val);
+// Sees each byte the serial port sends, after it is printed.
+typedef void    (*bus_serial_fn)(void *ctx, uint8_t byte);
+
 enum joypad_button {
     JOY_RIGHT  = 1u << 0,
     JOY_LEFT   = 1u << 1,
@@ -45,12 +54,22 @@ void    bus_write8(bus b, uint16_t addr, uint8_t val);
 uint16_t bus_read16(bus b, uint16_t addr);
 void    bus_write16(bus b, uint16_t addr, uint16_t val);    
 void    bus_tick(bus b, int cycles);
-void    bus_set_ly(bus b, uint8_t ly);
 void    bus_set_joypad_state(bus b, uint8_t pressed_mask);
 bool    bus_boot_rom_active(bus b);
 uint32_t bus_get_io_write_serial(bus b, uint16_t addr);
+uint32_t bus_get_oam_write_serial(bus b);
+const uint8_t *bus_get_vram(bus b);
+const uint8_t *bus_get_oam(bus b);
+uint8_t *bus_get_io(bus b);
+uint64_t bus_get_cycles(bus b);
+void    bus_set_ppu_sync(bus b, bus_sync_fn sync, void *ctx);
+void    bus_set_ppu_deadline(bus b, uint64_t cycle);
+void    bus_set_apu_io(bus b, bus_io_read_fn read, bus_io_write_fn write, void *ctx);
+void    bus_set_serial_out(bus b, bus_serial_fn out, void *ctx);
 
 bus bus_init(cartridge cart);
+bus bus_init_post_boot(cartridge cart);
+void bus_destroy(bus b);
 void snapshot_bus(bus b);
 
 #endif
@@ -62,6 +62,8 @@ void set_flag(cpu c, enum flag f, bool val);
 bool get_flag(cpu c, enum flag f);
 
 int cpu_step(cpu c);
+// Runs one opcode already fetched from PC-1 (operands follow at PC).
+void execute_opcode(cpu c, uint8_t opcode);
 uint8_t cpu_fetch8(cpu c);
 uint16_t cpu_fetch16(cpu c);
 
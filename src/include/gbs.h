@@ -0,0 +1,40 @@
+#ifndef GBS_H
+#define GBS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cart.h"
+
+typedef struct GBSFile* gbs_file;
+
+// A GBS v1 sound file: a game's music driver plus the addresses a player
+// calls. The driver is placed in a ROM image at its load address, with a
+// small player stub in the low bytes the format leaves free.
+struct GBSFile {
+    uint8_t  song_count;
+    uint8_t  first_song;        // 1-based
+    uint16_t load_addr;
+    uint16_t init_addr;
+    uint16_t play_addr;
+    uint16_t stack_ptr;
+    uint8_t  tma;
+    uint8_t  tac;               // bit 2 set: play on the timer, else at VBlank rate
+
+    char title[33];
+    char author[33];
+    char copyright[33];
+
+    cartridge cart;
+};
+
+// Returns NULL (after printing why) if path is not a usable GBS file.
+gbs_file gbs_load(const char *path);
+void gbs_free(gbs_file g);
+
+// Runs song (0-based) for seconds of emulated time on the CPU, timer and
+// APU only, with audio going to the sink described by sink_spec (see
+// apu_sink_open). Returns the wall-clock time it took in seconds.
+double gbs_render_song(gbs_file g, int song, double seconds, const char *sink_spec);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+typedef struct FramePacer* frame_pacer;
+
+// Holds emulation to real time by sleeping until an absolute deadline per
+// frame. Sleeps wake late by a host-dependent amount, so the pacer aims
+// early by a running estimate of that oversleep and, if asked, spins the
+// last spin_ns to land exactly on the deadline.
+struct FramePacer {
+    uint64_t deadline_ns;       // CLOCK_MONOTONIC time the current frame ends
+    uint64_t carry;             // remainder of the cycles -> ns division
+    int64_t  oversleep_ns;      // smoothed wake-up lateness
+    uint64_t spin_ns;
+
+    // Lateness of each wake against its deadline.
+    uint64_t frames;
+    uint64_t late_frames;       // woke more than a millisecond late
+    double   jitter_sum_us;
+    double   jitter_sq_us;
+    double   jitter_max_us;
+};
+
+struct frame_pacer_stats {
+    uint64_t frames;
+    uint64_t late_frames;
+    double   mean_us;
+    double   stddev_us;
+    double   max_us;
+    double   oversleep_us;
+};
+
+// EASYGB_PACE_SPIN_US sets the final spin (0-999 us, default 0: sleep only).
+frame_pacer pacer_init(void);
+void pacer_destroy(frame_pacer p);
+// Starts the next deadline from now, e.g. after a pause or another pacing mode.
+void pacer_reset(frame_pacer p);
+// Advances the deadline by cycles at hz and waits for it.
+void pacer_wait(frame_pacer p, uint64_t cycles, uint64_t hz);
+void pacer_get_stats(frame_pacer p, struct frame_pacer_stats *out);
+// The pacer's clock (CLOCK_MONOTONIC) in nanoseconds.
+uint64_t pacer_now_ns(void);
+
+#endif
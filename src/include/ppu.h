@@ -13,22 +13,129 @@
 #define KIB(x) ((x) * 1024)
 #endif
 
+enum {
+    PPU_MAX_SPRITES_PER_LINE = 10,
+    PPU_RENDER_NEVER = 0     // frame skip interval: keep timing, never compose
+};
+
+// Palette registers with an output LUT, indexing struct PPU.palette_luts.
+enum ppu_palette {
+    PPU_PAL_BGP = 0,
+    PPU_PAL_OBP0,
+    PPU_PAL_OBP1,
+    PPU_PAL_COUNT
+};
+
+// 2-bit color index -> output pixel for one palette register, rebuilt
+// only when the register or the color scheme changes.
+struct ppu_palette_lut {
+    int      reg_seen;      // register value the LUT was built for, -1: stale
+    uint32_t pixels[4];
+};
+
+// One OBJ selected for a scanline, already resolved to its tile row.
+struct ppu_sprite {
+    int16_t  x;         // screen X of the leftmost pixel (OAM X - 8)
+    uint16_t row_addr;  // VRAM offset of the row's low bitplane byte
+    uint8_t  flags;     // OAM attribute byte
+};
+
+struct PPU;
+typedef void (*ppu_line_renderer)(struct PPU *p, uint8_t line);
+
+#ifdef EASYGB_PPU_FIFO
+// Pixel-FIFO state for the line currently in mode 3 (accurate build only).
+// The BG FIFO is only refilled when empty, so it is one decoded tile row;
+// the OBJ FIFO is a ring of 8 slots lined up with the next output pixels.
+struct ppu_fifo {
+    int      lx;                // screen X of the next pixel to output
+    int      discard;           // pixels still to drop (SCX fine scroll, WX < 7)
+    int      startup;           // dots left of the discarded first tile fetch
+    int      fetch_step;        // 0-5 fetching, 6 waiting to push
+    int      sprite_stall;      // dots left of an OBJ fetch, 0 when none
+    int      next_sprite;       // next entry of the line's OBJ list
+    uint8_t  fetch_x;           // tile column of the fetcher
+    uint8_t  tile_id;
+    uint16_t tile_row_offset;   // byte offset of the fetched row inside the tile
+    uint8_t  tile_lo;
+    uint8_t  tile_hi;
+    bool     fetching_window;
+    uint16_t bg_row;            // decoded row, next pixel in bits 0-1
+    int      bg_count;
+    uint8_t  obj_head;
+    uint8_t  obj_color[8];
+    uint8_t  obj_flags[8];
+};
+#endif
+
 struct PPU {
     bus      mbus;
+    uint8_t *io;            // FF00-FF7F register file, shared with the bus
 
     int      mode;
     int      dot_counter;
     uint8_t  ly;
     bool     frame_ready;
+    bool     frame_rendered;    // whether the frame behind frame_ready was composed
     bool     lyc_equal_last;
     uint64_t frame_counter;
+    uint64_t last_sync;     // bus cycle the PPU has been run up to
+
+    // Compose 1 of every render_interval frames (PPU_RENDER_NEVER: none).
+    // Skipped frames keep full LY/STAT/interrupt timing.
+    uint32_t render_interval;
+    bool     render_this_frame;
+
+    // Per-line OBJ lists in drawing priority order (X, then OAM index),
+    // rebuilt during the OAM scan only when OAM or the OBJ size changed.
+    uint32_t oam_serial_seen;
+    int      sprite_height_seen;
+    uint8_t  line_sprite_count[144];
+    struct ppu_sprite line_sprites[144][PPU_MAX_SPRITES_PER_LINE];
+
+    // Line renderers specialized for the current LCDC, reselected when it changes.
+    int      lcdc_seen;
+    ppu_line_renderer render_bgwin;
+    ppu_line_renderer render_obj;
 
+    // BG/window color indices for the current line, with 8 pixels of slack
+    // on each side for whole-tile writes (screen X 0 is index 8).
+    uint8_t  bg_color_ids[8 + 160 + 8];
+
+    // Output: with an RGBA target set, lines are written there as 32-bit
+    // pixels through the palette LUTs; otherwise framebuffer gets shades.
+    uint32_t *rgba_pixels;
+    int      rgba_pitch;        // in pixels
+    uint32_t color_scheme[4];   // output pixel for shades 0-3
+    struct ppu_palette_lut palette_luts[PPU_PAL_COUNT];
     uint8_t  framebuffer[144][160];
+
+#ifdef EASYGB_PPU_FIFO
+    struct ppu_fifo fifo;
+    int      mode3_dots;        // length of the current line's mode 3 so far
+    uint64_t mode3_extra_dots;  // total mode-3 dots beyond the 172-dot minimum
+    uint8_t  window_line;       // internal window line counter
+    bool     window_wy_hit;     // LY matched WY at some point this frame
+    bool     window_on_line;    // the window was drawn on the current line
+#endif
 };
 
 typedef struct PPU* ppu;
 
 ppu  ppu_init(bus b);
-void ppu_step(ppu p, int cycles);
+// Detaches from the bus (which must still exist) and frees the PPU.
+void ppu_destroy(ppu p);
+// Runs the PPU up to the bus clock. It otherwise catches up only when the
+// CPU touches it or an interrupt or frame end is due, so from outside the
+// bus its framebuffer and LY/STAT are current only at frame_ready.
+void ppu_sync(ppu p);
+void ppu_set_frame_skip(ppu p, uint32_t render_interval);
+void ppu_set_rgba_target(ppu p, uint32_t *pixels, int pitch_bytes);
+void ppu_set_color_scheme(ppu p, const uint32_t colors[4]);
+#ifndef EASYGB_PPU_FIFO
+// Composes line from the current registers, VRAM and OAM as mode 3 would,
+// without advancing the PPU (for benchmarks).
+void ppu_render_scanline(ppu p, uint8_t line);
+#endif
 
 #endif
@@ -0,0 +1,29 @@
+#ifndef PROF_H
+#define PROF_H
+
+#include <signal.h>
+
+// Component the emulator is executing, for sampling profilers. Builds with
+// EASYGB_PROFILE keep prof_zone up to date (a store on entry and exit of
+// each component); a SIGPROF handler reading it then attributes host time
+// without timing every call. Other builds compile the markers away.
+enum prof_zone {
+    PROF_CPU,                   // everything not below
+    PROF_PPU,
+    PROF_APU,
+    PROF_TIMER,                 // DIV/TIMA stepping in bus_tick
+    PROF_ZONE_COUNT
+};
+
+#ifdef EASYGB_PROFILE
+extern volatile sig_atomic_t prof_zone;
+
+// Nests: the enclosing zone is restored by PROF_LEAVE in the same scope.
+#define PROF_ENTER(zone) sig_atomic_t prof_outer_ = prof_zone; prof_zone = (zone)
+#define PROF_LEAVE()     (prof_zone = prof_outer_)
+#else
+#define PROF_ENTER(zone) ((void)0)
+#define PROF_LEAVE()     ((void)0)
+#endif
+
+#endif
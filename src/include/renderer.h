@@ -6,11 +6,25 @@
 
 typedef struct GBRenderer* gb_renderer;
 
+#define RENDERER_SPEED_UNCAPPED 0.0
+
 gb_renderer renderer_init(int scale);
 void renderer_destroy(gb_renderer r);
 bool renderer_poll(gb_renderer r);
 uint8_t renderer_get_joypad_state(gb_renderer r);
-int renderer_get_speed_multiplier(gb_renderer r);
-void renderer_present(gb_renderer r, uint8_t framebuffer[144][160]);
+// Target speed as a multiple of real time: EASYGB_SPEED, then the 0-3 and
+// -/= keys, or uncapped while the fast-forward key (Tab) is held. Headless
+// runs default to uncapped.
+double renderer_get_speed(gb_renderer r);
+// Reports achieved speed (emulated clock / 4194304 Hz): window title, or
+// stdout headless.
+void renderer_show_speed(gb_renderer r, double achieved);
+// 160x144 RGBA8888 buffer the PPU should compose the next frame into,
+// valid until renderer_present (it may be the locked texture itself), or
+// NULL when the renderer shows nothing; pitch_bytes receives its row pitch.
+uint32_t *renderer_begin_frame(gb_renderer r, int *pitch_bytes);
+// User color scheme (EASYGB_PALETTE), if one was configured.
+bool renderer_get_color_scheme(gb_renderer r, uint32_t colors[4]);
+void renderer_present(gb_renderer r);
 
 #endif
@@ -0,0 +1,33 @@
+#ifndef SPSC_RING_H
+#define SPSC_RING_H
+
+#include <stdatomic.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct SPSCRing* spsc_ring;
+
+// Lock-free queue of fixed-size items between exactly one producer thread
+// and one consumer thread. Positions run freely and wrap through mask;
+// each side only ever stores its own position.
+struct SPSCRing {
+    uint8_t *items;
+    size_t   item_size;
+    uint32_t capacity;          // items, power of two
+    uint32_t mask;
+
+    _Atomic uint32_t write_pos;
+    _Atomic uint32_t read_pos;
+};
+
+spsc_ring spsc_ring_new(uint32_t min_items, size_t item_size);
+void spsc_ring_free(spsc_ring r);
+
+uint32_t spsc_ring_fill(spsc_ring r);
+uint32_t spsc_ring_space(spsc_ring r);
+
+// Both copy as many items as fit / are available and return that count.
+size_t spsc_ring_write(spsc_ring r, const void *items, size_t count);
+size_t spsc_ring_read(spsc_ring r, void *items, size_t count);
+
+#endif
@@ -3,7 +3,11 @@
 #include "include/ppu.h"
 #include "include/apu.h"
 #include "include/debug.h"
+#include "include/gbs.h"
+#include "include/pacer.h"
 #include "include/renderer.h"
+#include <errno.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,7 +19,19 @@
 #endif
 
 enum {
-    ROM_PATH_CAPACITY = 4096
+    ROM_PATH_CAPACITY = 4096,
+    GBS_DEFAULT_SECONDS = 120,
+    FRAME_CYCLES = 70224,           // 154 lines * 456 dots
+    GB_CPU_HZ = 4194304,
+    SERIAL_TAIL_SIZE = 256          // longest serial pattern + 1
+};
+
+// Exit status of a run: limits reached, or a --until/--fail-serial match.
+enum run_exit {
+    RUN_EXIT_PASSED = 0,            // until-serial seen, or the run ended without one asked for
+    RUN_EXIT_ERROR = 1,             // bad arguments or ROM (EXIT_FAILURE)
+    RUN_EXIT_FAILED = 2,            // fail-serial seen
+    RUN_EXIT_EXHAUSTED = 3          // frame/cycle limit reached before until-serial
 };
 
 #ifdef EASYGB_USE_SDL
@@ -79,21 +95,22 @@ static bool is_valid_rom_path(const char *path) {
 }
 #endif
 
-static const char *resolve_rom_path(int argc, char const *argv[], char *selected_rom, size_t selected_rom_size) {
-    if (argc == 2) {
-        return argv[1];
-    }
+static void print_usage(const char *argv0) {
+    fprintf(stderr, "Usage: %s [--frames N] [--cycles N] [--until-serial TEXT] "
+            "[--fail-serial TEXT] [file.gb | file.gbs]\n", argv0);
+}
 
-    if (argc > 2) {
-        fprintf(stderr, "Usage: %s [file.gb]\n", argv[0]);
-        return NULL;
+static const char *resolve_rom_path(const char *rom_arg, const char *argv0, char *selected_rom,
+                                    size_t selected_rom_size) {
+    if (rom_arg != NULL) {
+        return rom_arg;
     }
 
 #ifdef EASYGB_USE_SDL
     if (!pick_rom_path(selected_rom, selected_rom_size)) {
         fprintf(stderr, "No ROM provided and no graphical file picker was completed.\n");
         fprintf(stderr, "Install zenity/kdialog or pass the ROM path as argument.\n");
-        fprintf(stderr, "Usage: %s [file.gb]\n", argv[0]);
+        print_usage(argv0);
         return NULL;
     }
 
@@ -106,11 +123,137 @@ static const char *resolve_rom_path(int argc, char const *argv[], char *selected
 #else
     (void)selected_rom;
     (void)selected_rom_size;
-    fprintf(stderr, "Usage: %s [file.gb]\n", argv[0]);
+    print_usage(argv0);
     return NULL;
 #endif
 }
 
+// Where a run stops on its own; unset (0 / NULL) limits never trigger.
+struct run_limits {
+    uint64_t frames;
+    uint64_t cycles;
+    const char *until_serial;   // stop with RUN_EXIT_PASSED once printed
+    const char *fail_serial;    // stop with RUN_EXIT_FAILED once printed
+};
+
+static bool parse_count(const char *opt, const char *text, uint64_t *out) {
+    char *end = NULL;
+    errno = 0;
+    unsigned long long v = strtoull(text, &end, 10);
+    if (errno != 0 || end == text || *end != '\0' || v == 0u || text[0] == '-') {
+        fprintf(stderr, "%s needs a positive count, got '%s'\n", opt, text);
+        return false;
+    }
+    *out = (uint64_t)v;
+    return true;
+}
+
+static bool parse_args(int argc, char const *argv[], struct run_limits *limits,
+                       const char **rom_arg) {
+    memset(limits, 0, sizeof(*limits));
+    *rom_arg = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        if (strncmp(arg, "--", 2) != 0) {
+            if (*rom_arg != NULL) {
+                print_usage(argv[0]);
+                return false;
+            }
+            *rom_arg = arg;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "%s needs a value\n", arg);
+            return false;
+        }
+        const char *value = argv[++i];
+        if (strcmp(arg, "--frames") == 0) {
+            if (!parse_count(arg, value, &limits->frames)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--cycles") == 0) {
+            if (!parse_count(arg, value, &limits->cycles)) {
+                return false;
+            }
+        } else if (strcmp(arg, "--until-serial") == 0 || strcmp(arg, "--fail-serial") == 0) {
+            size_t len = strlen(value);
+            if (len == 0u || len >= SERIAL_TAIL_SIZE) {
+                fprintf(stderr, "%s needs 1-%d characters\n", arg, SERIAL_TAIL_SIZE - 1);
+                return false;
+            }
+            if (arg[2] == 'u') {
+                limits->until_serial = value;
+            } else {
+                limits->fail_serial = value;
+            }
+        } else {
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool has_extension(const char *path, const char *ext) {
+    const char *dot = strrchr(path, '.');
+    return dot != NULL && strcasecmp(dot, ext) == 0;
+}
+
+// .gbs files are rendered headless, faster than real time, one WAV per
+// song named PREFIX-NN.wav. EASYGB_GBS_SONG picks a single (1-based)
+// song, EASYGB_GBS_SECONDS the length of each (default 120) and
+// EASYGB_GBS_OUT the prefix (default: the file's path without extension).
+static int run_gbs_player(const char *path) {
+    gbs_file g = gbs_load(path);
+    if (g == NULL) {
+        return EXIT_FAILURE;
+    }
+    printf("[INFO] GBS: %s / %s / %s, %u songs, %s-driven\n", g->title, g->author, g->copyright,
+           g->song_count, (g->tac & 0x04u) != 0u ? "timer" : "VBlank");
+
+    const char *env = getenv("EASYGB_GBS_SECONDS");
+    double seconds = env != NULL ? atof(env) : 0.0;
+    if (seconds <= 0.0) {
+        seconds = GBS_DEFAULT_SECONDS;
+    }
+
+    int first = 1;
+    int last = g->song_count;
+    env = getenv("EASYGB_GBS_SONG");
+    if (env != NULL && env[0] != '\0') {
+        int song = atoi(env);
+        if (song < 1 || song > g->song_count) {
+            fprintf(stderr, "EASYGB_GBS_SONG must be 1-%u\n", g->song_count);
+            gbs_free(g);
+            return EXIT_FAILURE;
+        }
+        first = song;
+        last = song;
+    }
+
+    char prefix[ROM_PATH_CAPACITY];
+    env = getenv("EASYGB_GBS_OUT");
+    snprintf(prefix, sizeof(prefix), "%s", env != NULL && env[0] != '\0' ? env : path);
+    if (env == NULL || env[0] == '\0') {
+        char *dot = strrchr(prefix, '.');
+        if (dot != NULL && strchr(dot, '/') == NULL) {
+            *dot = '\0';
+        }
+    }
+
+    for (int song = first; song <= last; song++) {
+        char spec[ROM_PATH_CAPACITY + 32];
+        snprintf(spec, sizeof(spec), "wav:%s-%02d.wav", prefix, song);
+        double wall = gbs_render_song(g, song - 1, seconds, spec);
+        printf("[INFO] Song %d -> %s (%.0fx real time)\n", song, spec + 4,
+               wall > 0.0 ? seconds / wall : 0.0);
+    }
+
+    gbs_free(g);
+    return EXIT_SUCCESS;
+}
+
 cartridge cart;
 bus mbus;
 cpu mcpu;
@@ -118,16 +261,167 @@ ppu mppu;
 apu mapu;
 gb_renderer mrender;
 
+// Points the PPU at the renderer's buffer for the next composed frame.
+static void bind_frame_target(void) {
+    int pitch_bytes = 0;
+    uint32_t *pixels = renderer_begin_frame(mrender, &pitch_bytes);
+    ppu_set_rgba_target(mppu, pixels, pitch_bytes);
+}
+
+// Samples input once and applies it at the current cycle, i.e. at a frame
+// boundary: the joypad only changes between frames, never mid-instruction.
+static void poll_input(bool *running, uint8_t *joypad) {
+    *running = renderer_poll(mrender);
+    uint8_t state = renderer_get_joypad_state(mrender);
+    if (state != *joypad) {
+        bus_set_joypad_state(mbus, state);
+        *joypad = state;
+    }
+}
+
+// Runs the CPU until the PPU finishes a frame, or for budget cycles (a
+// frame's worth when none comes with the LCD off), then closes the audio
+// frame. A budget can run out mid-frame, right after the LCD comes back
+// on, so the PPU is synced there to leave it where an eager one would be.
+static void run_frame(int budget) {
+    int frame_cycles = 0;
+    while (frame_cycles < budget) {
+        frame_cycles += cpu_step(mcpu);
+
+        if (mppu->frame_ready) {
+            if (mppu->frame_rendered) {
+                renderer_present(mrender);
+                bind_frame_target();
+            }
+            mppu->frame_ready = false;
+            apu_end_frame(mapu);
+            return;
+        }
+    }
+    ppu_sync(mppu);
+    apu_end_frame(mapu);
+}
+
+// Matches serial output against the --until-serial / --fail-serial text,
+// case-insensitively, as it is sent.
+struct serial_watch {
+    const char *until;
+    const char *fail;
+    char tail[SERIAL_TAIL_SIZE];    // latest bytes, not NUL-terminated
+    size_t len;
+    bool passed;
+    bool failed;
+};
+
+static bool tail_ends_with(const struct serial_watch *w, const char *text) {
+    size_t n = text != NULL ? strlen(text) : 0u;
+    return n != 0u && w->len >= n && strncasecmp(&w->tail[w->len - n], text, n) == 0;
+}
+
+static void serial_watch_byte(void *ctx, uint8_t byte) {
+    struct serial_watch *w = (struct serial_watch *)ctx;
+    if (w->len == sizeof(w->tail)) {
+        size_t keep = sizeof(w->tail) / 2u;
+        memmove(w->tail, &w->tail[w->len - keep], keep);
+        w->len = keep;
+    }
+    w->tail[w->len++] = (char)byte;
+    w->passed = w->passed || tail_ends_with(w, w->until);
+    w->failed = w->failed || tail_ends_with(w, w->fail);
+}
+
+// Achieved speed, emulated cycles per wall second over GB_CPU_HZ, measured
+// over windows of about a second.
+struct speed_meter {
+    uint64_t since_ns;
+    uint64_t since_cycle;
+    double   achieved;
+};
+
+// True when a window closed and achieved has a new value.
+static bool speed_meter_update(struct speed_meter *m) {
+    uint64_t now = pacer_now_ns();
+    uint64_t elapsed = now - m->since_ns;
+    if (elapsed < 1000000000u) {
+        return false;
+    }
+    uint64_t cycles = bus_get_cycles(mbus);
+    m->achieved = (double)(cycles - m->since_cycle) * 1e9 / ((double)elapsed * GB_CPU_HZ);
+    m->since_ns = now;
+    m->since_cycle = cycles;
+    return true;
+}
+
+#ifdef EASYGB_USE_SDL
+// Above 1x, presents 1 of every ceil(speed) frames: about what real time shows.
+static uint32_t frame_skip_for(double speed) {
+    return speed <= 1.0 ? 1u : (uint32_t)ceil(speed);
+}
+
+enum {
+    AUDIO_PACE_MAX_WAIT_MS = 100,
+    AUDIO_PACE_SMOOTHING = 8    // frames the fill error is averaged over
+};
+
+// EASYGB_PACING=audio slaves emulation to the audio device: only sinks
+// that queue ahead of a real-time consumer can drive it.
+static bool audio_pacing_requested(void) {
+    const char *mode = getenv("EASYGB_PACING");
+    struct apu_sink_stats stats;
+
+    if (mode == NULL || strcmp(mode, "audio") != 0) {
+        return false;
+    }
+    if (!apu_sink_get_stats(apu_get_sink(mapu), &stats)) {
+        dbg_log("EASYGB_PACING=audio needs SDL audio output, using timer pacing");
+        return false;
+    }
+    return true;
+}
+
+// Sleeps while more than the target is queued, then trims the output rate
+// by up to APU_MAX_RATE_ADJUST toward the target fill. The fill is read
+// after the wait, where the loop holds it at or under the target before
+// the next frame is queued, and averaged over a few frames: it sits at
+// the target (ratio 1.0) unless the host falls behind the device clock.
+static void pace_to_audio(double *fill_error) {
+    apu_sink sink = apu_get_sink(mapu);
+    struct apu_sink_stats stats;
+
+    for (int waited = 0; waited < AUDIO_PACE_MAX_WAIT_MS; waited++) {
+        apu_sink_get_stats(sink, &stats);
+        if (stats.queued_frames <= stats.target_frames) {
+            break;
+        }
+        SDL_Delay(1);
+    }
+
+    double error = ((double)stats.target_frames - (double)stats.queued_frames) /
+                   (double)stats.target_frames;
+    *fill_error += (error - *fill_error) / AUDIO_PACE_SMOOTHING;
+    apu_set_rate_adjust(mapu, 1.0 + APU_MAX_RATE_ADJUST * *fill_error);
+}
+#endif
+
 int main(int argc, char const *argv[]){
     dbg_init();
 
+    struct run_limits limits;
+    const char *rom_arg = NULL;
+    if (!parse_args(argc, argv, &limits, &rom_arg)) {
+        return RUN_EXIT_ERROR;
+    }
+
     char selected_rom[ROM_PATH_CAPACITY] = {0};
-    const char *rom_path = resolve_rom_path(argc, argv, selected_rom, sizeof(selected_rom));
+    const char *rom_path = resolve_rom_path(rom_arg, argv[0], selected_rom, sizeof(selected_rom));
     if (rom_path == NULL) {
         return EXIT_FAILURE;
     }
 
     printf("%s\n", rom_path);
+    if (has_extension(rom_path, ".gbs")) {
+        return run_gbs_player(rom_path);
+    }
     dbg_log("Booting ROM: %s", rom_path);
 
     cart = read_cart(rom_path);
@@ -139,83 +433,126 @@ int main(int argc, char const *argv[]){
         return EXIT_FAILURE;
     }
     mapu = apu_init(mbus);
+
+    uint32_t colors[4];
+    if (renderer_get_color_scheme(mrender, colors)) {
+        ppu_set_color_scheme(mppu, colors);
+    }
+    bind_frame_target();
     
     // snapshot_bus(mbus);
 
+    struct serial_watch watch = {.until = limits.until_serial, .fail = limits.fail_serial};
+    if (limits.until_serial != NULL || limits.fail_serial != NULL) {
+        bus_set_serial_out(mbus, serial_watch_byte, &watch);
+    }
+    uint64_t start_cycle = bus_get_cycles(mbus);
+    uint64_t frames = 0;
+    int status = RUN_EXIT_PASSED;
+    const char *stop_reason = NULL;
+
     bool running = true;
+    uint8_t joypad = 0;
+    frame_pacer pacer = pacer_init();
+    struct speed_meter meter = {pacer_now_ns(), bus_get_cycles(mbus), 1.0};
+    double last_speed = renderer_get_speed(mrender);
 #ifdef EASYGB_USE_SDL
-    const int cycles_per_frame = 70224; // 154 lines * 456 dots
-    const uint64_t gb_cpu_hz = 4194304u;
-    uint64_t perf_freq = SDL_GetPerformanceFrequency();
-    if (perf_freq == 0u) {
-        perf_freq = 1u;
-    }
-    uint64_t next_frame_tick = SDL_GetPerformanceCounter();
+    uint32_t frame_skip = 1;
+    bool audio_pacing = audio_pacing_requested();
+    double audio_fill_error = 0.0;
+#else
+    // Nothing consumes frames headless: keep PPU timing, skip composition.
+    ppu_set_frame_skip(mppu, PPU_RENDER_NEVER);
+    // EASYGB_SHOW_SPEED=1 prints the achieved speed about once a second.
+    const char *show_speed = getenv("EASYGB_SHOW_SPEED");
+    bool speed_readout = show_speed != NULL && strcmp(show_speed, "1") == 0;
 #endif
     while (running) {
-#ifdef EASYGB_USE_SDL
-        running = renderer_poll(mrender);
+        poll_input(&running, &joypad);
         if (!running) {
             break;
         }
-        bus_set_joypad_state(mbus, renderer_get_joypad_state(mrender));
-        int frame_cycles = 0;
-        while (running && frame_cycles < cycles_per_frame) {
-            int cycles = cpu_step(mcpu);
-            ppu_step(mppu, cycles);
-            apu_step(mapu, cycles);
-            frame_cycles += cycles;
-
-            if (mppu->frame_ready) {
-                renderer_present(mrender, mppu->framebuffer);
-                mppu->frame_ready = false;
-                break;
+        int budget = FRAME_CYCLES;
+        if (limits.cycles != 0u) {
+            uint64_t left = limits.cycles - (bus_get_cycles(mbus) - start_cycle);
+            budget = left < (uint64_t)budget ? (int)left : budget;
+        }
+        run_frame(budget);
+        frames++;
+
+        if (watch.failed) {
+            status = RUN_EXIT_FAILED;
+            stop_reason = "fail-serial text seen";
+        } else if (watch.passed) {
+            stop_reason = "until-serial text seen";
+        } else if (limits.frames != 0u && frames >= limits.frames) {
+            stop_reason = "frame limit reached";
+        } else if (limits.cycles != 0u && bus_get_cycles(mbus) - start_cycle >= limits.cycles) {
+            stop_reason = "cycle limit reached";
+        }
+        if (stop_reason != NULL) {
+            if (status == RUN_EXIT_PASSED && limits.until_serial != NULL && !watch.passed) {
+                status = RUN_EXIT_EXHAUSTED;
             }
+            break;
         }
 
-        int speed_multiplier = renderer_get_speed_multiplier(mrender);
-        if (speed_multiplier < 1) {
-            speed_multiplier = 1;
+        double speed = renderer_get_speed(mrender);
+        if (speed != last_speed) {
+            last_speed = speed;
+            pacer_reset(pacer);
+            apu_set_rate_adjust(mapu, 1.0);
+#ifdef EASYGB_USE_SDL
+            audio_fill_error = 0.0;
+#endif
+        }
+#ifdef EASYGB_USE_SDL
+        if (speed_meter_update(&meter)) {
+            renderer_show_speed(mrender, meter.achieved);
         }
 
-        uint64_t frame_ticks =
-            ((uint64_t)cycles_per_frame * perf_freq) /
-            (gb_cpu_hz * (uint64_t)speed_multiplier);
-        if (frame_ticks == 0u) {
-            frame_ticks = 1u;
+        // Away from 1x, compose and present only as many frames as real time shows.
+        uint32_t skip = frame_skip_for(speed == RENDERER_SPEED_UNCAPPED ? meter.achieved : speed);
+        if (skip != frame_skip) {
+            ppu_set_frame_skip(mppu, skip);
+            frame_skip = skip;
         }
 
-        next_frame_tick += frame_ticks;
-        uint64_t now = SDL_GetPerformanceCounter();
-        if (now < next_frame_tick) {
-            uint64_t remaining_ticks = next_frame_tick - now;
-            uint32_t delay_ms = (uint32_t)((remaining_ticks * 1000u) / perf_freq);
-            if (delay_ms > 1u) {
-                SDL_Delay(delay_ms - 1u);
-            }
-            while (SDL_GetPerformanceCounter() < next_frame_tick) {
-            }
-        } else if ((now - next_frame_tick) > perf_freq) {
-            // If we are very late (e.g. debugger pause), resync to current time.
-            next_frame_tick = now;
+        // Other speeds outrun or starve the audio device, so they keep timer pacing.
+        if (audio_pacing && speed == 1.0) {
+            pace_to_audio(&audio_fill_error);
+            pacer_reset(pacer);
+            continue;
         }
 #else
-        running = renderer_poll(mrender);
-        bus_set_joypad_state(mbus, renderer_get_joypad_state(mrender));
-
-        int cycles = cpu_step(mcpu);
-        ppu_step(mppu, cycles);
-        apu_step(mapu, cycles);
-
-        if (mppu->frame_ready) {
-            renderer_present(mrender, mppu->framebuffer);
-            mppu->frame_ready = false;
+        if (speed_meter_update(&meter) && speed_readout) {
+            renderer_show_speed(mrender, meter.achieved);
         }
 #endif
+        if (speed != RENDERER_SPEED_UNCAPPED) {
+            pacer_wait(pacer, FRAME_CYCLES, (uint64_t)(GB_CPU_HZ * speed + 0.5));
+        }
     }
 
+    struct frame_pacer_stats pace;
+    pacer_get_stats(pacer, &pace);
+    if (pace.frames != 0u) {
+        printf("[INFO] Frame pacing: %llu frames, jitter mean %.0f us, stddev %.0f us, "
+               "max %.0f us, %llu late, sleep lead %.0f us\n",
+               (unsigned long long)pace.frames, pace.mean_us, pace.stddev_us, pace.max_us,
+               (unsigned long long)pace.late_frames, pace.oversleep_us);
+    }
+    pacer_destroy(pacer);
     apu_destroy(mapu);
     renderer_destroy(mrender);
-    
-    return 0;
+
+    if (watch.len != 0u && watch.tail[watch.len - 1u] != '\n') {
+        putchar('\n');
+    }
+    if (stop_reason != NULL) {
+        printf("[INFO] Stopped after %llu frames, %llu cycles: %s (exit %d)\n",
+               (unsigned long long)frames,
+               (unsigned long long)(bus_get_cycles(mbus) - start_cycle), stop_reason, status);
+    }
+    return status;
 }
@@ -0,0 +1,129 @@
+#include "include/pacer.h"
+
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+enum {
+    PACER_MAX_SPIN_US = 999,        // the spin only finishes a sleep: keep it sub-millisecond
+    PACER_MAX_OVERSLEEP_NS = 2000000,
+    PACER_LATE_NS = 1000000,
+    PACER_RESYNC_NS = 1000000000    // this far behind (debugger, suspend): start over
+};
+
+static const uint64_t NS_PER_SEC = 1000000000u;
+
+uint64_t pacer_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_until(uint64_t target_ns) {
+#ifdef __APPLE__
+    // No clock_nanosleep: sleep the relative remainder instead.
+    uint64_t now = pacer_now_ns();
+    if (target_ns <= now) {
+        return;
+    }
+    uint64_t rel = target_ns - now;
+    struct timespec ts = {(time_t)(rel / NS_PER_SEC), (long)(rel % NS_PER_SEC)};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR) {
+    }
+#else
+    struct timespec ts = {(time_t)(target_ns / NS_PER_SEC), (long)(target_ns % NS_PER_SEC)};
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+    }
+#endif
+}
+
+frame_pacer pacer_init(void) {
+    frame_pacer p = (frame_pacer)calloc(1, sizeof(struct FramePacer));
+    if (p == NULL) {
+        perror("[ERROR] Failed frame pacer allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    const char *spin = getenv("EASYGB_PACE_SPIN_US");
+    if (spin != NULL) {
+        long us = strtol(spin, NULL, 10);
+        if (us < 0) {
+            us = 0;
+        } else if (us > PACER_MAX_SPIN_US) {
+            us = PACER_MAX_SPIN_US;
+        }
+        p->spin_ns = (uint64_t)us * 1000u;
+    }
+    pacer_reset(p);
+    return p;
+}
+
+void pacer_destroy(frame_pacer p) {
+    free(p);
+}
+
+void pacer_reset(frame_pacer p) {
+    p->deadline_ns = pacer_now_ns();
+    p->carry = 0;
+}
+
+void pacer_wait(frame_pacer p, uint64_t cycles, uint64_t hz) {
+    uint64_t span = cycles * NS_PER_SEC + p->carry;
+    p->deadline_ns += span / hz;
+    p->carry = span % hz;
+
+    uint64_t now = pacer_now_ns();
+    if (now >= p->deadline_ns) {
+        if (now - p->deadline_ns > PACER_RESYNC_NS) {
+            pacer_reset(p);
+        }
+        return;     // behind already: run the next frame straight away
+    }
+
+    // Wake early by the expected oversleep plus the spin window.
+    uint64_t lead = (uint64_t)p->oversleep_ns + p->spin_ns;
+    if (p->deadline_ns - now > lead) {
+        uint64_t target = p->deadline_ns - lead;
+        sleep_until(target);
+        int64_t error = (int64_t)(pacer_now_ns() - target) - p->oversleep_ns;
+        p->oversleep_ns += error / 8;
+        if (p->oversleep_ns < 0) {
+            p->oversleep_ns = 0;
+        } else if (p->oversleep_ns > PACER_MAX_OVERSLEEP_NS) {
+            p->oversleep_ns = PACER_MAX_OVERSLEEP_NS;
+        }
+    }
+    if (p->spin_ns != 0u) {
+        while (pacer_now_ns() < p->deadline_ns) {
+        }
+    }
+
+    int64_t off = (int64_t)(pacer_now_ns() - p->deadline_ns);
+    double jitter_us = (double)(off < 0 ? -off : off) / 1000.0;
+    p->frames++;
+    if (off > PACER_LATE_NS) {
+        p->late_frames++;
+    }
+    p->jitter_sum_us += jitter_us;
+    p->jitter_sq_us += jitter_us * jitter_us;
+    if (jitter_us > p->jitter_max_us) {
+        p->jitter_max_us = jitter_us;
+    }
+}
+
+void pacer_get_stats(frame_pacer p, struct frame_pacer_stats *out) {
+    out->frames = p->frames;
+    out->late_frames = p->late_frames;
+    out->mean_us = 0.0;
+    out->stddev_us = 0.0;
+    out->max_us = p->jitter_max_us;
+    out->oversleep_us = (double)p->oversleep_ns / 1000.0;
+    if (p->frames != 0u) {
+        double n = (double)p->frames;
+        out->mean_us = p->jitter_sum_us / n;
+        double var = p->jitter_sq_us / n - out->mean_us * out->mean_us;
+        out->stddev_us = var > 0.0 ? sqrt(var) : 0.0;
+    }
+}
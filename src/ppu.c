@@ -1,5 +1,6 @@
 #include "include/ppu.h"
 #include "include/debug.h"
+#include "include/prof.h"
 
 enum {
     LCDC_ADDR = 0xFF40,
@@ -11,51 +12,119 @@ enum {
     OBP0_ADDR = 0xFF48,
     OBP1_ADDR = 0xFF49,
     BGP_ADDR = 0xFF47,
+    WY_ADDR = 0xFF4A,
+    WX_ADDR = 0xFF4B,
     IF_ADDR = 0xFF0F
 };
 
 enum {
     SCREEN_HEIGHT = 144,
     SCREEN_WIDTH = 160,
-    DOTS_PER_LINE = 456
+    DOTS_PER_LINE = 456,
+    MODE3_START_DOT = 80,
+    MODE0_START_DOT = 252,
+    LINES_PER_FRAME = 154,
+    OAM_ENTRIES = 40
 };
 
+// tile_row_lut spreads one bitplane byte so that pixel N (N=0 leftmost)
+// lands in bits 2N..2N+1; bit_reverse_lut mirrors a byte for X-flip.
+static uint16_t tile_row_lut[256];
+static uint8_t bit_reverse_lut[256];
+static bool ppu_luts_ready = false;
+
+static void ppu_init_luts(void) {
+    if (ppu_luts_ready) {
+        return;
+    }
+
+    for (int v = 0; v < 256; v++) {
+        uint16_t spread = 0;
+        uint8_t reversed = 0;
+        for (int bit = 0; bit < 8; bit++) {
+            if ((v & (1 << bit)) != 0) {
+                spread |= (uint16_t)(1u << ((7 - bit) * 2));
+                reversed |= (uint8_t)(1u << (7 - bit));
+            }
+        }
+        tile_row_lut[v] = spread;
+        bit_reverse_lut[v] = reversed;
+    }
+
+    ppu_luts_ready = true;
+}
+
+static inline uint16_t decode_tile_row(uint8_t lo, uint8_t hi) {
+    return (uint16_t)(tile_row_lut[lo] | (uint16_t)(tile_row_lut[hi] << 1));
+}
+
+// Default output colors (RGBA8888), the classic DMG green.
+static const uint32_t default_color_scheme[4] = {
+    0xE0F8D0FFu, 0x88C070FFu, 0x346856FFu, 0x081820FFu
+};
+
+#ifndef EASYGB_PPU_FIFO
+static const uint32_t *palette_lut(ppu p, enum ppu_palette pal, uint8_t reg) {
+    struct ppu_palette_lut *lut = &p->palette_luts[pal];
+    if (lut->reg_seen != (int)reg) {
+        for (int c = 0; c < 4; c++) {
+            lut->pixels[c] = p->color_scheme[(reg >> (c * 2)) & 0x03u];
+        }
+        lut->reg_seen = reg;
+    }
+    return lut->pixels;
+}
+#endif
+
+static inline uint32_t *rgba_row(ppu p, uint8_t line) {
+    return &p->rgba_pixels[(size_t)line * (size_t)p->rgba_pitch];
+}
+
+// The PPU owns LY and the STAT mode/coincidence bits and raises IF bits
+// itself, writing straight into the IO register file: the guest reads the
+// same bytes through the bus, but the PPU skips the decoder, the IO write
+// side effects and the re-entrant sync a bus access would cost.
+static inline uint8_t io_read(const struct PPU *p, uint16_t addr) {
+    return p->io[addr - 0xFF00u];
+}
+
+static inline void io_write(ppu p, uint16_t addr, uint8_t value) {
+    p->io[addr - 0xFF00u] = value;
+}
+
 static inline void write_io_ly(ppu p, uint8_t value) {
     p->ly = value;
-    bus_set_ly(p->mbus, value);
+    io_write(p, LY_ADDR, value);
 }
 
 static inline void write_io_stat_mode(ppu p, int mode) {
-    uint8_t stat = bus_read8(p->mbus, STAT_ADDR);
-    uint8_t new_stat = (uint8_t)((stat & 0xFCu) | ((uint8_t)mode & 0x03u));
-    if (new_stat != stat) {
-        bus_write8(p->mbus, STAT_ADDR, new_stat);
-    }
+    uint8_t stat = io_read(p, STAT_ADDR);
+    io_write(p, STAT_ADDR, (uint8_t)((stat & 0xFCu) | ((uint8_t)mode & 0x03u)));
+}
+
+// Upper IF bits read back as 1, as after any bus write to IF.
+static inline void request_interrupt(ppu p, uint8_t mask) {
+    io_write(p, IF_ADDR, (uint8_t)(io_read(p, IF_ADDR) | 0xE0u | mask));
 }
 
 static inline void request_vblank_interrupt(ppu p) {
-    uint8_t old = bus_read8(p->mbus, IF_ADDR);
-    bus_write8(p->mbus, IF_ADDR, (uint8_t)(old | 0x01u));
+    request_interrupt(p, 0x01u);
 }
 
 static inline void request_lcd_stat_interrupt(ppu p) {
-    uint8_t old = bus_read8(p->mbus, IF_ADDR);
-    bus_write8(p->mbus, IF_ADDR, (uint8_t)(old | 0x02u));
+    request_interrupt(p, 0x02u);
 }
 
 static void update_lyc_compare(ppu p) {
-    uint8_t stat = bus_read8(p->mbus, STAT_ADDR);
-    uint8_t lyc = bus_read8(p->mbus, LYC_ADDR);
+    uint8_t stat = io_read(p, STAT_ADDR);
+    uint8_t lyc = io_read(p, LYC_ADDR);
     bool equal = (p->ly == lyc);
 
     uint8_t new_stat = equal ? (uint8_t)(stat | 0x04u)
                              : (uint8_t)(stat & (uint8_t)~0x04u);
-    if (new_stat != stat) {
-        bus_write8(p->mbus, STAT_ADDR, new_stat);
-        stat = new_stat;
-    }
+    io_write(p, STAT_ADDR, new_stat);
 
-    if (equal && !p->lyc_equal_last && ((stat & 0x40u) != 0u)) {
+    if (equal && !p->lyc_equal_last && ((new_stat & 0x40u) != 0u)) {
         request_lcd_stat_interrupt(p);
         dbg_log("PPU STAT IRQ (LYC==LY) LY=%u", (unsigned)p->ly);
     }
@@ -72,7 +141,7 @@ static void enter_mode(ppu p, int mode) {
     p->mode = mode;
     write_io_stat_mode(p, mode);
 
-    uint8_t stat = bus_read8(p->mbus, STAT_ADDR);
+    uint8_t stat = io_read(p, STAT_ADDR);
     bool stat_irq = false;
 
     if (mode == 0 && (stat & 0x08u) != 0u) {
@@ -91,64 +160,51 @@ static void enter_mode(ppu p, int mode) {
     dbg_log("PPU mode %d->%d LY=%u dot=%d", old_mode, mode, (unsigned)p->ly, p->dot_counter);
 }
 
-static void render_scanline_bg(ppu p) {
-    uint8_t lcdc = bus_read8(p->mbus, LCDC_ADDR);
-    uint8_t line = p->ly;
-    if (line >= SCREEN_HEIGHT) {
-        return;
+// Two tile-data layouts selected by LCDC bit 4, as VRAM offsets:
+// unsigned IDs from 0x8000, signed IDs around 0x9000.
+static inline __attribute__((always_inline))
+uint16_t tile_data_offset(uint8_t tile_id, bool signed_ids) {
+    if (signed_ids) {
+        return (uint16_t)(0x1000 + ((int16_t)(int8_t)tile_id * 16));
     }
+    return (uint16_t)((uint16_t)tile_id * 16u);
+}
 
-    if ((lcdc & 0x01u) == 0u) {
-        memset(p->framebuffer[line], 0, sizeof(p->framebuffer[line]));
-        return;
+#ifndef EASYGB_PPU_FIFO
+
+static inline __attribute__((always_inline))
+void emit_tile_row(uint8_t *dst, uint16_t row) {
+    for (int px = 0; px < 8; px++) {
+        dst[px] = (uint8_t)((row >> (px * 2)) & 0x03u);
     }
+}
 
-    uint8_t scy = bus_read8(p->mbus, SCY_ADDR);
-    uint8_t scx = bus_read8(p->mbus, SCX_ADDR);
-    uint8_t bgp = bus_read8(p->mbus, BGP_ADDR);
-    uint16_t map_base = (lcdc & 0x08u) != 0u ? 0x9C00u : 0x9800u;
-    bool unsigned_tile_ids = (lcdc & 0x10u) != 0u;
+// BG and window write whole tiles into bg_color_ids, which has eight
+// pixels of slack on both sides, so the tile loops never clip.
+static inline __attribute__((always_inline))
+void render_scanline_bg(ppu p, uint8_t *ids, uint8_t line,
+                        uint16_t map_offset, bool signed_ids) {
+    const uint8_t *vram = bus_get_vram(p->mbus);
+    uint8_t scy = io_read(p, SCY_ADDR);
+    uint8_t scx = io_read(p, SCX_ADDR);
 
     uint8_t bg_y = (uint8_t)(scy + line);
-    uint16_t tile_row = (uint16_t)(bg_y >> 3) * 32u;
-    uint8_t row_in_tile = (uint8_t)(bg_y & 0x07u);
-
-    for (int x = 0; x < SCREEN_WIDTH; x++) {
-        uint8_t bg_x = (uint8_t)(scx + (uint8_t)x);
-        uint16_t map_addr = (uint16_t)(map_base + tile_row + (uint16_t)(bg_x >> 3));
-        uint8_t tile_id = bus_read8(p->mbus, map_addr);
+    const uint8_t *map_row = &vram[map_offset + (uint16_t)(bg_y >> 3) * 32u];
+    uint16_t row_offset = (uint16_t)((bg_y & 0x07u) * 2u);
+    uint8_t tile_col = (uint8_t)(scx >> 3);
 
-        uint16_t tile_base;
-        if (unsigned_tile_ids) {
-            tile_base = (uint16_t)(0x8000u + ((uint16_t)tile_id * 16u));
-        } else {
-            int16_t signed_id = (int16_t)(int8_t)tile_id;
-            tile_base = (uint16_t)(0x9000 + (signed_id * 16));
-        }
-
-        uint16_t tile_addr = (uint16_t)(tile_base + ((uint16_t)row_in_tile * 2u));
-        uint8_t lo = bus_read8(p->mbus, tile_addr);
-        uint8_t hi = bus_read8(p->mbus, (uint16_t)(tile_addr + 1u));
-        int bit = 7 - (bg_x & 0x07u);
-        uint8_t color_id = (uint8_t)((((hi >> bit) & 0x01u) << 1) | ((lo >> bit) & 0x01u));
-        uint8_t shade = (uint8_t)((bgp >> (color_id * 2u)) & 0x03u);
-        p->framebuffer[line][x] = shade;
+    for (int x = -(int)(scx & 0x07u); x < SCREEN_WIDTH; x += 8) {
+        uint16_t addr = (uint16_t)(tile_data_offset(map_row[tile_col], signed_ids) + row_offset);
+        emit_tile_row(&ids[x], decode_tile_row(vram[addr], vram[addr + 1u]));
+        tile_col = (uint8_t)((tile_col + 1u) & 0x1Fu);
     }
 }
 
-static void render_scanline_window(ppu p) {
-    uint8_t lcdc = bus_read8(p->mbus, LCDC_ADDR);
-    uint8_t line = p->ly;
-    if (line >= SCREEN_HEIGHT) {
-        return;
-    }
-
-    if ((lcdc & 0x20u) == 0u || (lcdc & 0x01u) == 0u) {
-        return;
-    }
-
-    uint8_t wy = bus_read8(p->mbus, 0xFF4A);
-    uint8_t wx = bus_read8(p->mbus, 0xFF4B);
+static inline __attribute__((always_inline))
+void render_scanline_window(ppu p, uint8_t *ids, uint8_t line,
+                            uint16_t map_offset, bool signed_ids) {
+    uint8_t wy = io_read(p, WY_ADDR);
+    uint8_t wx = io_read(p, WX_ADDR);
     if (line < wy) {
         return;
     }
@@ -158,164 +214,586 @@ static void render_scanline_window(ppu p) {
         return;
     }
 
-    int start_x = win_x0 < 0 ? 0 : win_x0;
-    uint8_t bgp = bus_read8(p->mbus, BGP_ADDR);
-    uint16_t map_base = (lcdc & 0x40u) != 0u ? 0x9C00u : 0x9800u;
-    bool unsigned_tile_ids = (lcdc & 0x10u) != 0u;
-
+    const uint8_t *vram = bus_get_vram(p->mbus);
     uint8_t win_y = (uint8_t)(line - wy);
-    uint16_t tile_row = (uint16_t)(win_y >> 3) * 32u;
-    uint8_t row_in_tile = (uint8_t)(win_y & 0x07u);
+    const uint8_t *map_row = &vram[map_offset + (uint16_t)(win_y >> 3) * 32u];
+    uint16_t row_offset = (uint16_t)((win_y & 0x07u) * 2u);
+    uint8_t tile_col = 0;
 
-    for (int x = start_x; x < SCREEN_WIDTH; x++) {
-        uint8_t win_x = (uint8_t)(x - win_x0);
-        uint16_t map_addr = (uint16_t)(map_base + tile_row + (uint16_t)(win_x >> 3));
-        uint8_t tile_id = bus_read8(p->mbus, map_addr);
+    for (int x = win_x0; x < SCREEN_WIDTH; x += 8) {
+        uint16_t addr = (uint16_t)(tile_data_offset(map_row[tile_col], signed_ids) + row_offset);
+        emit_tile_row(&ids[x], decode_tile_row(vram[addr], vram[addr + 1u]));
+        tile_col = (uint8_t)((tile_col + 1u) & 0x1Fu);
+    }
+}
 
-        uint16_t tile_base;
-        if (unsigned_tile_ids) {
-            tile_base = (uint16_t)(0x8000u + ((uint16_t)tile_id * 16u));
-        } else {
-            int16_t signed_id = (int16_t)(int8_t)tile_id;
-            tile_base = (uint16_t)(0x9000 + (signed_id * 16));
+static inline __attribute__((always_inline))
+void render_scanline_bgwin(ppu p, uint8_t line, uint16_t bg_map, bool signed_ids,
+                           bool window, uint16_t win_map) {
+    uint8_t *ids = &p->bg_color_ids[8];
+    render_scanline_bg(p, ids, line, bg_map, signed_ids);
+    if (window) {
+        render_scanline_window(p, ids, line, win_map, signed_ids);
+    }
+
+    uint8_t bgp = io_read(p, BGP_ADDR);
+    if (p->rgba_pixels != NULL) {
+        const uint32_t *lut = palette_lut(p, PPU_PAL_BGP, bgp);
+        uint32_t *dst = rgba_row(p, line);
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            dst[x] = lut[ids[x]];
         }
+        return;
+    }
 
-        uint16_t tile_addr = (uint16_t)(tile_base + ((uint16_t)row_in_tile * 2u));
-        uint8_t lo = bus_read8(p->mbus, tile_addr);
-        uint8_t hi = bus_read8(p->mbus, (uint16_t)(tile_addr + 1u));
-        int bit = 7 - (win_x & 0x07u);
-        uint8_t color_id = (uint8_t)((((hi >> bit) & 0x01u) << 1) | ((lo >> bit) & 0x01u));
-        uint8_t shade = (uint8_t)((bgp >> (color_id * 2u)) & 0x03u);
-        p->framebuffer[line][x] = shade;
+    uint8_t shades[4];
+    for (int c = 0; c < 4; c++) {
+        shades[c] = (uint8_t)((bgp >> (c * 2)) & 0x03u);
+    }
+
+    uint8_t *dst = p->framebuffer[line];
+    for (int x = 0; x < SCREEN_WIDTH; x++) {
+        dst[x] = shades[ids[x]];
     }
 }
 
-static void render_scanline_obj(ppu p) {
-    uint8_t lcdc = bus_read8(p->mbus, LCDC_ADDR);
-    uint8_t line = p->ly;
-    if (line >= SCREEN_HEIGHT) {
-        return;
+// LCDC bit 0 clear blanks both BG and window on DMG.
+static void render_bgwin_blank(ppu p, uint8_t line) {
+    if (p->rgba_pixels != NULL) {
+        uint32_t *dst = rgba_row(p, line);
+        for (int x = 0; x < SCREEN_WIDTH; x++) {
+            dst[x] = p->color_scheme[0];
+        }
+    } else {
+        memset(p->framebuffer[line], 0, sizeof(p->framebuffer[line]));
     }
+    memset(p->bg_color_ids, 0, sizeof(p->bg_color_ids));
+}
 
-    if ((lcdc & 0x02u) == 0u) {
-        return;
+// One BG/window line renderer per LCDC bit 4/3/5/6 combination, so the
+// tile loops above are compiled with the addressing mode, map bases and
+// window presence as constants. Names read render_bgwin_<tile IDs>_<BG
+// map>_<window map>: signed (8800 addressing) or unsigned (8000), the BG
+// map base, and the window map base or nowin when LCDC.5 is clear.
+#define DEFINE_BGWIN_RENDERER(name, bg_map, signed_ids, window, win_map) \
+    static void name(ppu p, uint8_t line) {                              \
+        render_scanline_bgwin(p, line, bg_map, signed_ids, window, win_map); \
     }
 
-    uint8_t obp0 = bus_read8(p->mbus, OBP0_ADDR);
-    uint8_t obp1 = bus_read8(p->mbus, OBP1_ADDR);
-    int sprite_h = ((lcdc & 0x04u) != 0u) ? 16 : 8;
-    int sprites_on_line = 0;
+DEFINE_BGWIN_RENDERER(render_bgwin_signed_bg9800_nowin,     0x1800u, true,  false, 0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_signed_bg9800_win9800,   0x1800u, true,  true,  0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_signed_bg9800_win9c00,   0x1800u, true,  true,  0x1C00u)
+DEFINE_BGWIN_RENDERER(render_bgwin_signed_bg9c00_nowin,     0x1C00u, true,  false, 0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_signed_bg9c00_win9800,   0x1C00u, true,  true,  0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_signed_bg9c00_win9c00,   0x1C00u, true,  true,  0x1C00u)
+DEFINE_BGWIN_RENDERER(render_bgwin_unsigned_bg9800_nowin,   0x1800u, false, false, 0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_unsigned_bg9800_win9800, 0x1800u, false, true,  0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_unsigned_bg9800_win9c00, 0x1800u, false, true,  0x1C00u)
+DEFINE_BGWIN_RENDERER(render_bgwin_unsigned_bg9c00_nowin,   0x1C00u, false, false, 0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_unsigned_bg9c00_win9800, 0x1C00u, false, true,  0x1800u)
+DEFINE_BGWIN_RENDERER(render_bgwin_unsigned_bg9c00_win9c00, 0x1C00u, false, true,  0x1C00u)
 
-    for (int i = 0; i < 40; i++) {
-        uint16_t base = (uint16_t)(0xFE00u + (uint16_t)(i * 4));
-        int sy = (int)bus_read8(p->mbus, base) - 16;
-        int sx = (int)bus_read8(p->mbus, (uint16_t)(base + 1u)) - 8;
-        uint8_t tile = bus_read8(p->mbus, (uint16_t)(base + 2u));
-        uint8_t flags = bus_read8(p->mbus, (uint16_t)(base + 3u));
+#undef DEFINE_BGWIN_RENDERER
 
-        int y = (int)line - sy;
-        if (y < 0 || y >= sprite_h) {
-            continue;
-        }
+// Indexed by [LCDC.4 tile data][LCDC.3 BG map][window: off, 9800, 9C00].
+static const ppu_line_renderer bgwin_renderers[2][2][3] = {
+    {
+        {render_bgwin_signed_bg9800_nowin,
+         render_bgwin_signed_bg9800_win9800,
+         render_bgwin_signed_bg9800_win9c00},
+        {render_bgwin_signed_bg9c00_nowin,
+         render_bgwin_signed_bg9c00_win9800,
+         render_bgwin_signed_bg9c00_win9c00}
+    },
+    {
+        {render_bgwin_unsigned_bg9800_nowin,
+         render_bgwin_unsigned_bg9800_win9800,
+         render_bgwin_unsigned_bg9800_win9c00},
+        {render_bgwin_unsigned_bg9c00_nowin,
+         render_bgwin_unsigned_bg9c00_win9800,
+         render_bgwin_unsigned_bg9c00_win9c00}
+    }
+};
 
-        if (++sprites_on_line > 10) {
-            break;
-        }
+#endif // !EASYGB_PPU_FIFO
 
-        if ((flags & 0x40u) != 0u) {
-            y = sprite_h - 1 - y;
-        }
+// OAM scan: select up to ten OBJs per line in OAM order (the DMG limit),
+// keeping each list sorted by X so that drawing in list order resolves
+// overlaps the way the hardware does (lower X wins, then lower OAM index).
+static void rebuild_line_sprites(ppu p, int sprite_h) {
+    const uint8_t *oam = bus_get_oam(p->mbus);
+    memset(p->line_sprite_count, 0, sizeof(p->line_sprite_count));
+
+    for (int i = 0; i < OAM_ENTRIES; i++) {
+        const uint8_t *entry = &oam[i * 4];
+        int sy = (int)entry[0] - 16;
+        int sx = (int)entry[1] - 8;
+        uint8_t tile = entry[2];
+        uint8_t flags = entry[3];
 
         if (sprite_h == 16) {
             tile &= 0xFEu;
-            if (y >= 8) {
-                tile = (uint8_t)(tile + 1u);
-                y -= 8;
+        }
+
+        int first = sy < 0 ? 0 : sy;
+        int last = sy + sprite_h;
+        if (last > SCREEN_HEIGHT) {
+            last = SCREEN_HEIGHT;
+        }
+
+        for (int line = first; line < last; line++) {
+            uint8_t count = p->line_sprite_count[line];
+            if (count >= PPU_MAX_SPRITES_PER_LINE) {
+                continue;
             }
+
+            int row = line - sy;
+            if ((flags & 0x40u) != 0u) {
+                row = sprite_h - 1 - row;
+            }
+
+            struct ppu_sprite *list = p->line_sprites[line];
+            int pos = count;
+            while (pos > 0 && list[pos - 1].x > sx) {
+                list[pos] = list[pos - 1];
+                pos--;
+            }
+
+            list[pos].x = (int16_t)sx;
+            list[pos].row_addr = (uint16_t)(((uint16_t)tile << 4) + ((uint16_t)row << 1));
+            list[pos].flags = flags;
+            p->line_sprite_count[line] = (uint8_t)(count + 1u);
         }
+    }
+
+    dbg_log("PPU OAM scan rebuilt sprite lists (h=%d)", sprite_h);
+}
+
+static void scan_oam(ppu p) {
+    uint8_t lcdc = io_read(p, LCDC_ADDR);
+    int sprite_h = ((lcdc & 0x04u) != 0u) ? 16 : 8;
+    uint32_t serial = bus_get_oam_write_serial(p->mbus);
 
-        uint16_t tile_addr = (uint16_t)(0x8000u + ((uint16_t)tile << 4) + ((uint16_t)y << 1));
-        uint8_t lo = bus_read8(p->mbus, tile_addr);
-        uint8_t hi = bus_read8(p->mbus, (uint16_t)(tile_addr + 1u));
-        uint8_t pal = ((flags & 0x10u) != 0u) ? obp1 : obp0;
-        bool bg_priority = (flags & 0x80u) != 0u;
-        bool xflip = (flags & 0x20u) != 0u;
+    if (serial != p->oam_serial_seen || sprite_h != p->sprite_height_seen) {
+        p->oam_serial_seen = serial;
+        p->sprite_height_seen = sprite_h;
+        rebuild_line_sprites(p, sprite_h);
+    }
+}
+
+#ifndef EASYGB_PPU_FIFO
 
-        for (int px = 0; px < 8; px++) {
-            int bit = xflip ? px : (7 - px);
-            uint8_t color_id = (uint8_t)((((hi >> bit) & 0x01u) << 1) | ((lo >> bit) & 0x01u));
+static void render_scanline_obj(ppu p, uint8_t line) {
+    const uint8_t *vram = bus_get_vram(p->mbus);
+    uint8_t obp0 = io_read(p, OBP0_ADDR);
+    uint8_t obp1 = io_read(p, OBP1_ADDR);
+    const struct ppu_sprite *list = p->line_sprites[line];
+    int count = p->line_sprite_count[line];
+    bool obj_drawn[SCREEN_WIDTH];
+    memset(obj_drawn, 0, sizeof(obj_drawn));
+
+    uint32_t *dst_rgba = NULL;
+    const uint32_t *obp_luts[2] = {NULL, NULL};
+    if (p->rgba_pixels != NULL && count > 0) {
+        dst_rgba = rgba_row(p, line);
+        obp_luts[0] = palette_lut(p, PPU_PAL_OBP0, obp0);
+        obp_luts[1] = palette_lut(p, PPU_PAL_OBP1, obp1);
+    }
+
+    for (int i = 0; i < count; i++) {
+        const struct ppu_sprite *s = &list[i];
+        uint8_t lo = vram[s->row_addr];
+        uint8_t hi = vram[s->row_addr + 1u];
+        if ((s->flags & 0x20u) != 0u) {
+            lo = bit_reverse_lut[lo];
+            hi = bit_reverse_lut[hi];
+        }
+
+        uint16_t row = decode_tile_row(lo, hi);
+        bool use_obp1 = (s->flags & 0x10u) != 0u;
+        uint8_t pal = use_obp1 ? obp1 : obp0;
+        const uint32_t *lut = obp_luts[use_obp1 ? 1 : 0];
+        bool bg_priority = (s->flags & 0x80u) != 0u;
+
+        for (int px = 0; px < 8 && row != 0u; px++, row >>= 2) {
+            uint8_t color_id = (uint8_t)(row & 0x03u);
             if (color_id == 0u) {
                 continue; // Transparent for OBJ
             }
 
-            int x = sx + px;
-            if (x < 0 || x >= SCREEN_WIDTH) {
+            int x = s->x + px;
+            if (x < 0 || x >= SCREEN_WIDTH || obj_drawn[x]) {
                 continue;
             }
 
-            if (bg_priority && p->framebuffer[line][x] != 0u) {
+            // A higher-priority OBJ pixel hides lower ones even when the
+            // background ends up winning over it.
+            obj_drawn[x] = true;
+            if (bg_priority && p->bg_color_ids[x + 8] != 0u) {
                 continue;
             }
 
-            uint8_t shade = (uint8_t)((pal >> (color_id << 1)) & 0x03u);
-            p->framebuffer[line][x] = shade;
+            if (dst_rgba != NULL) {
+                dst_rgba[x] = lut[color_id];
+            } else {
+                p->framebuffer[line][x] = (uint8_t)((pal >> (color_id << 1)) & 0x03u);
+            }
         }
     }
 }
 
-static void update_mode_during_visible_line(ppu p) {
-    int dot = p->dot_counter;
+static void render_obj_none(ppu p, uint8_t line) {
+    (void)p;
+    (void)line;
+}
 
-    if (dot < 80) {
-        enter_mode(p, 2);
+static void select_line_renderers(ppu p, uint8_t lcdc) {
+    if ((lcdc & 0x01u) == 0u) {
+        p->render_bgwin = render_bgwin_blank;
+    } else {
+        int tiles = (lcdc & 0x10u) != 0u ? 1 : 0;
+        int bg_map = (lcdc & 0x08u) != 0u ? 1 : 0;
+        int window = 0;
+        if ((lcdc & 0x20u) != 0u) {
+            window = (lcdc & 0x40u) != 0u ? 2 : 1;
+        }
+        p->render_bgwin = bgwin_renderers[tiles][bg_map][window];
+    }
+
+    p->render_obj = (lcdc & 0x02u) != 0u ? render_scanline_obj : render_obj_none;
+    p->lcdc_seen = lcdc;
+    dbg_log("PPU line renderers selected for LCDC=%02X", (unsigned)lcdc);
+}
+
+static void render_line(ppu p) {
+    uint8_t line = p->ly;
+    if (line >= SCREEN_HEIGHT) {
         return;
     }
 
-    if (dot < 252) {
-        if (p->mode != 3) {
-            enter_mode(p, 3);
-            render_scanline_bg(p);
-            render_scanline_window(p);
-            render_scanline_obj(p);
-            dbg_log("PPU rendered line LY=%u", (unsigned)p->ly);
+    uint8_t lcdc = io_read(p, LCDC_ADDR);
+    if ((int)lcdc != p->lcdc_seen) {
+        select_line_renderers(p, lcdc);
+    }
+
+    p->render_bgwin(p, line);
+    p->render_obj(p, line);
+}
+
+void ppu_render_scanline(ppu p, uint8_t line) {
+    uint8_t ly = p->ly;
+    scan_oam(p);
+    p->ly = line;
+    render_line(p);
+    p->ly = ly;
+}
+
+#else // EASYGB_PPU_FIFO
+
+// Accurate build: mode 3 is a dot-by-dot pixel FIFO. Its length follows
+// from the work done (SCX fine scroll, window restart, OBJ fetch stalls),
+// and every register the fetcher or mixer reads is sampled at the dot it
+// is used, so mid-line writes land on the right pixel.
+
+enum {
+    FIFO_FETCH_PUSH = 6,    // fetcher step that waits for an empty BG FIFO
+    FIFO_STARTUP_DOTS = 6,  // the first tile fetch of a line is thrown away
+    FIFO_OBJ_FETCH_DOTS = 6,
+    MODE3_MIN_DOTS = 172
+};
+
+// Registers are sampled once per fifo_run call: any guest write syncs the
+// PPU first, so they cannot change inside one run.
+struct fifo_regs {
+    uint8_t lcdc;
+    uint8_t scy;
+    uint8_t scx;
+    uint8_t wx;
+    uint8_t bgp;
+    uint8_t obp0;
+    uint8_t obp1;
+};
+
+static void fifo_begin_line(ppu p) {
+    struct ppu_fifo *f = &p->fifo;
+    memset(f, 0, sizeof(*f));
+    f->startup = FIFO_STARTUP_DOTS;
+    f->discard = io_read(p, SCX_ADDR) & 0x07u;
+    p->mode3_dots = 0;
+}
+
+static void fifo_fetch_step(ppu p, struct ppu_fifo *f, const struct fifo_regs *r) {
+    const uint8_t *vram = bus_get_vram(p->mbus);
+    bool signed_ids = (r->lcdc & 0x10u) == 0u;
+
+    switch (f->fetch_step) {
+    case 1: {
+        uint16_t map;
+        uint8_t row;
+        uint8_t col;
+        if (f->fetching_window) {
+            map = (r->lcdc & 0x40u) != 0u ? 0x1C00u : 0x1800u;
+            row = p->window_line;
+            col = f->fetch_x;
+        } else {
+            map = (r->lcdc & 0x08u) != 0u ? 0x1C00u : 0x1800u;
+            row = (uint8_t)(p->ly + r->scy);
+            col = (uint8_t)((r->scx >> 3) + f->fetch_x);
+        }
+        f->tile_id = vram[map + (uint16_t)(row >> 3) * 32u + (col & 0x1Fu)];
+        f->tile_row_offset = (uint16_t)((row & 0x07u) * 2u);
+        break;
+    }
+    case 3:
+        f->tile_lo = vram[tile_data_offset(f->tile_id, signed_ids) + f->tile_row_offset];
+        break;
+    case 5:
+        f->tile_hi = vram[tile_data_offset(f->tile_id, signed_ids) + f->tile_row_offset + 1u];
+        break;
+    case FIFO_FETCH_PUSH:
+        if (f->bg_count == 0) {
+            f->bg_row = decode_tile_row(f->tile_lo, f->tile_hi);
+            f->bg_count = 8;
+            f->fetch_x++;
+            f->fetch_step = 0;
         }
         return;
+    default:
+        break;
     }
 
-    enter_mode(p, 0);
+    f->fetch_step++;
 }
 
-ppu ppu_init(bus b) {
-    ppu p = (ppu)malloc(sizeof(struct PPU));
-    if (p == NULL) {
-        perror("[ERROR] Failed PPU allocation!");
-        exit(EXIT_FAILURE);
+// Merges the row of the OBJ at next_sprite into the OBJ FIFO. Slots that
+// already hold an opaque pixel keep it: earlier list entries win.
+static void fifo_merge_sprite(ppu p, struct ppu_fifo *f) {
+    const struct ppu_sprite *s = &p->line_sprites[p->ly][f->next_sprite++];
+    const uint8_t *vram = bus_get_vram(p->mbus);
+    uint8_t lo = vram[s->row_addr];
+    uint8_t hi = vram[s->row_addr + 1u];
+    if ((s->flags & 0x20u) != 0u) {
+        lo = bit_reverse_lut[lo];
+        hi = bit_reverse_lut[hi];
     }
 
-    p->mbus = b;
-    p->mode = 0;
-    p->dot_counter = 0;
-    p->ly = 0;
-    p->frame_ready = false;
-    p->lyc_equal_last = false;
-    p->frame_counter = 0;
+    uint16_t row = decode_tile_row(lo, hi);
+    for (int px = 0; px < 8; px++, row >>= 2) {
+        int slot = s->x + px - f->lx;
+        uint8_t color_id = (uint8_t)(row & 0x03u);
+        if (slot < 0 || color_id == 0u) {
+            continue;
+        }
 
-    memset(p->framebuffer, 0, sizeof(p->framebuffer));
+        int idx = (f->obj_head + slot) & 0x07;
+        if (f->obj_color[idx] == 0u) {
+            f->obj_color[idx] = color_id;
+            f->obj_flags[idx] = s->flags;
+        }
+    }
+}
 
-    write_io_ly(p, 0);
-    write_io_stat_mode(p, 0);
-    update_lyc_compare(p);
+static void fifo_output_pixel(ppu p, struct ppu_fifo *f, const struct fifo_regs *r,
+                              uint8_t bg_id) {
+    uint8_t obj_id = f->obj_color[f->obj_head];
+    uint8_t obj_flags = f->obj_flags[f->obj_head];
+    f->obj_color[f->obj_head] = 0u;
+    f->obj_head = (uint8_t)((f->obj_head + 1u) & 0x07u);
 
-    dbg_log("PPU init complete");
-    return p;
+    // LCDC bit 0 clear blanks BG and window and lets every OBJ pixel win.
+    uint8_t shade = 0u;
+    if ((r->lcdc & 0x01u) != 0u) {
+        shade = (uint8_t)((r->bgp >> (bg_id << 1)) & 0x03u);
+    } else {
+        bg_id = 0u;
+    }
+
+    if (obj_id != 0u && (r->lcdc & 0x02u) != 0u &&
+        !((obj_flags & 0x80u) != 0u && bg_id != 0u)) {
+        uint8_t pal = (obj_flags & 0x10u) != 0u ? r->obp1 : r->obp0;
+        shade = (uint8_t)((pal >> (obj_id << 1)) & 0x03u);
+    }
+
+    if (p->render_this_frame) {
+        if (p->rgba_pixels != NULL) {
+            rgba_row(p, p->ly)[f->lx] = p->color_scheme[shade];
+        } else {
+            p->framebuffer[p->ly][f->lx] = shade;
+        }
+    }
+    f->lx++;
+}
+
+static void fifo_tick(ppu p, struct ppu_fifo *f, const struct fifo_regs *r) {
+    if (f->startup > 0) {
+        f->startup--;
+        return;
+    }
+
+    if (f->sprite_stall > 0) {
+        if (--f->sprite_stall == 0) {
+            fifo_merge_sprite(p, f);
+        }
+        return;
+    }
+
+    // Window start: the BG FIFO is flushed and the fetcher restarts on the
+    // window map, which costs a fresh tile fetch.
+    if (!f->fetching_window && (r->lcdc & 0x21u) == 0x21u && p->window_wy_hit &&
+        f->discard == 0 && f->lx >= (int)r->wx - 7) {
+        f->fetching_window = true;
+        f->fetch_x = 0;
+        f->fetch_step = 0;
+        f->bg_count = 0;
+        if (r->wx < 7u) {
+            f->discard = 7 - r->wx;
+        }
+        p->window_on_line = true;
+        return;
+    }
+
+    // OBJ fetch: wait for the BG fetcher to reach its last fetch step, then
+    // stall the pixel output while the OBJ row is read.
+    int sprite_count = p->line_sprite_count[p->ly];
+    while ((r->lcdc & 0x02u) != 0u && f->next_sprite < sprite_count && f->discard == 0) {
+        const struct ppu_sprite *s = &p->line_sprites[p->ly][f->next_sprite];
+        if (s->x <= -8) {
+            f->next_sprite++;
+            continue;
+        }
+        if (f->lx < s->x) {
+            break;
+        }
+        if (f->fetch_step < 5) {
+            fifo_fetch_step(p, f, r);
+            return;
+        }
+        f->sprite_stall = FIFO_OBJ_FETCH_DOTS;
+        return;
+    }
+
+    fifo_fetch_step(p, f, r);
+    if (f->bg_count == 0) {
+        return;
+    }
+
+    uint8_t bg_id = (uint8_t)(f->bg_row & 0x03u);
+    f->bg_row >>= 2;
+    f->bg_count--;
+
+    if (f->discard > 0) {
+        f->discard--;
+        return;
+    }
+    fifo_output_pixel(p, f, r, bg_id);
+}
+
+// Runs mode 3 up to the given line dot; true once all 160 pixels are out.
+static bool fifo_run(ppu p, int until_dot) {
+    struct ppu_fifo *f = &p->fifo;
+    struct fifo_regs r = {
+        .lcdc = io_read(p, LCDC_ADDR),
+        .scy = io_read(p, SCY_ADDR),
+        .scx = io_read(p, SCX_ADDR),
+        .wx = io_read(p, WX_ADDR),
+        .bgp = io_read(p, BGP_ADDR),
+        .obp0 = io_read(p, OBP0_ADDR),
+        .obp1 = io_read(p, OBP1_ADDR)
+    };
+
+    while (f->lx < SCREEN_WIDTH && MODE3_START_DOT + p->mode3_dots < until_dot) {
+        fifo_tick(p, f, &r);
+        p->mode3_dots++;
+    }
+
+    if (f->lx < SCREEN_WIDTH) {
+        return false;
+    }
+    p->mode3_extra_dots += (uint64_t)(p->mode3_dots - MODE3_MIN_DOTS);
+    return true;
+}
+
+// Each pixel takes at least one dot, so this never overshoots mode 0.
+static int fifo_min_dots_left(const struct PPU *p) {
+    int left = SCREEN_WIDTH - p->fifo.lx + p->fifo.discard;
+    return left > 0 ? left : 1;
+}
+
+static void fifo_begin_oam_scan(ppu p) {
+    if (p->window_on_line) {
+        p->window_line++;
+        p->window_on_line = false;
+    }
+    if (p->ly == io_read(p, WY_ADDR)) {
+        p->window_wy_hit = true;
+    }
+}
+
+#endif // EASYGB_PPU_FIFO
+
+static void begin_frame(ppu p) {
+    p->render_this_frame = p->render_interval != PPU_RENDER_NEVER &&
+                           (p->frame_counter % p->render_interval) == 0u;
+#ifdef EASYGB_PPU_FIFO
+    p->window_line = 0;
+    p->window_wy_hit = false;
+    p->window_on_line = false;
+#endif
+}
+
+static void update_mode_during_visible_line(ppu p) {
+    int dot = p->dot_counter;
+
+#ifdef EASYGB_PPU_FIFO
+    // OBJ fetches stall mode 3 even on frames that are not composed.
+    if (dot < MODE3_START_DOT) {
+        if (p->mode != 2) {
+            enter_mode(p, 2);
+            scan_oam(p);
+            fifo_begin_oam_scan(p);
+        }
+        return;
+    }
+
+    if (p->mode == 2) {
+        enter_mode(p, 3);
+        fifo_begin_line(p);
+    }
+    if (p->mode == 3 && !fifo_run(p, dot)) {
+        return;
+    }
+#else
+    if (dot < MODE3_START_DOT) {
+        if (p->mode != 2) {
+            enter_mode(p, 2);
+            if (p->render_this_frame) {
+                scan_oam(p);
+            }
+        }
+        return;
+    }
+
+    if (dot < MODE0_START_DOT) {
+        if (p->mode != 3) {
+            enter_mode(p, 3);
+            if (p->render_this_frame) {
+                render_line(p);
+                dbg_log("PPU rendered line LY=%u", (unsigned)p->ly);
+            }
+        }
+        return;
+    }
+#endif
+
+    enter_mode(p, 0);
 }
 
-void ppu_step(ppu p, int cycles) {
+static void ppu_run_dots(ppu p, int cycles) {
     if (cycles <= 0) {
         return;
     }
 
-    uint8_t lcdc = bus_read8(p->mbus, LCDC_ADDR);
+    uint8_t lcdc = io_read(p, LCDC_ADDR);
     if ((lcdc & 0x80u) == 0u) {
         if (p->dot_counter != 0 || p->ly != 0 || p->mode != 0) {
             p->dot_counter = 0;
@@ -339,24 +817,37 @@ void ppu_step(ppu p, int cycles) {
         if (next_ly > 153u) {
             next_ly = 0u;
             p->frame_ready = true;
+            p->frame_rendered = p->render_this_frame;
             p->frame_counter++;
+            begin_frame(p);
             if (dbg_enabled() && (p->frame_counter % 60u) == 0u) {
-                int nonzero = 0;
-                for (int y = 0; y < SCREEN_HEIGHT; y++) {
-                    for (int x = 0; x < SCREEN_WIDTH; x++) {
-                        if (p->framebuffer[y][x] != 0u) {
-                            nonzero++;
+                // The shade buffer only holds this frame when it was composed
+                // there: skipped frames and frames drawn into a bound RGBA
+                // target leave it stale, so those report no count.
+                char nonzero_text[16] = "n/a";
+                if (p->frame_rendered && p->rgba_pixels == NULL) {
+                    int nonzero = 0;
+                    for (int y = 0; y < SCREEN_HEIGHT; y++) {
+                        for (int x = 0; x < SCREEN_WIDTH; x++) {
+                            if (p->framebuffer[y][x] != 0u) {
+                                nonzero++;
+                            }
                         }
                     }
+                    snprintf(nonzero_text, sizeof(nonzero_text), "%d", nonzero);
                 }
 
-                dbg_log("PPU frame=%llu nonzero_pixels=%d LCDC=%02X BGP=%02X SCX=%02X SCY=%02X",
+                dbg_log("PPU frame=%llu nonzero_pixels=%s LCDC=%02X BGP=%02X SCX=%02X SCY=%02X",
                         (unsigned long long)p->frame_counter,
-                        nonzero,
-                        (unsigned)bus_read8(p->mbus, LCDC_ADDR),
-                        (unsigned)bus_read8(p->mbus, BGP_ADDR),
-                        (unsigned)bus_read8(p->mbus, SCX_ADDR),
-                        (unsigned)bus_read8(p->mbus, SCY_ADDR));
+                        nonzero_text,
+                        (unsigned)io_read(p, LCDC_ADDR),
+                        (unsigned)io_read(p, BGP_ADDR),
+                        (unsigned)io_read(p, SCX_ADDR),
+                        (unsigned)io_read(p, SCY_ADDR));
+#ifdef EASYGB_PPU_FIFO
+                dbg_log("PPU FIFO mode 3 extra dots: %.1f per frame",
+                        (double)p->mode3_extra_dots / (double)p->frame_counter);
+#endif
             }
             dbg_log("PPU frame ready");
         }
@@ -377,3 +868,191 @@ void ppu_step(ppu p, int cycles) {
         enter_mode(p, 1);
     }
 }
+
+// Dots until mode 0 on the current visible line, or 0 once it has begun.
+// The FIFO build returns a lower bound and is asked again when it is hit.
+static int dots_to_mode0(const struct PPU *p) {
+    int dot = p->dot_counter;
+#ifdef EASYGB_PPU_FIFO
+    if (p->mode == 3) {
+        return fifo_min_dots_left(p);
+    }
+    if (dot < MODE3_START_DOT) {
+        return MODE0_START_DOT - dot;
+    }
+    return 0;
+#else
+    return dot < MODE0_START_DOT ? MODE0_START_DOT - dot : 0;
+#endif
+}
+
+static int dots_to_next_boundary(const struct PPU *p) {
+    if (p->ly < SCREEN_HEIGHT) {
+        if (p->dot_counter < MODE3_START_DOT) {
+            return MODE3_START_DOT - p->dot_counter;
+        }
+        int to_mode0 = dots_to_mode0(p);
+        if (to_mode0 > 0) {
+            return to_mode0;
+        }
+    }
+    return DOTS_PER_LINE - p->dot_counter;
+}
+
+// Dots until the PPU next raises an interrupt or finishes a frame, given
+// the current STAT enables and LYC. Nothing else it does is observable
+// without going through the bus, which syncs on its own.
+static uint32_t dots_to_next_event(const struct PPU *p, uint8_t stat, uint8_t lyc) {
+    int ly = p->ly;
+    int dot = p->dot_counter;
+    uint32_t dots = 0;
+
+    if (ly < SCREEN_HEIGHT && (stat & 0x08u) != 0u) {
+        int to_mode0 = dots_to_mode0(p);
+        if (to_mode0 > 0) {
+            return (uint32_t)to_mode0;
+        }
+    }
+
+    for (;;) {
+        if (dots > 0u && ly < SCREEN_HEIGHT && (stat & 0x08u) != 0u) {
+            return dots + MODE0_START_DOT;
+        }
+
+        dots += (uint32_t)(DOTS_PER_LINE - dot);
+        dot = 0;
+        ly++;
+
+        if (ly >= LINES_PER_FRAME || ly == SCREEN_HEIGHT) {
+            return dots;
+        }
+        if (ly < SCREEN_HEIGHT && (stat & 0x20u) != 0u) {
+            return dots;
+        }
+        if ((stat & 0x40u) != 0u && ly == lyc) {
+            return dots;
+        }
+    }
+}
+
+// Replays the cycles since the last sync one mode boundary at a time, so
+// every mode entry, render and interrupt happens exactly as if the PPU
+// had been stepped after each instruction.
+static void ppu_catch_up(void *ctx) {
+    ppu p = (ppu)ctx;
+    uint64_t now = bus_get_cycles(p->mbus);
+    if (now == p->last_sync) {
+        return;
+    }
+
+    uint64_t cycles = now - p->last_sync;
+    p->last_sync = now;
+    PROF_ENTER(PROF_PPU);
+
+    if ((io_read(p, LCDC_ADDR) & 0x80u) == 0u) {
+        ppu_run_dots(p, 1);
+        bus_set_ppu_deadline(p->mbus, UINT64_MAX);
+        PROF_LEAVE();
+        return;
+    }
+
+    while (cycles > 0u) {
+        uint64_t chunk = (uint64_t)dots_to_next_boundary(p);
+        if (chunk > cycles) {
+            chunk = cycles;
+        }
+        ppu_run_dots(p, (int)chunk);
+        cycles -= chunk;
+    }
+
+    uint8_t stat = io_read(p, STAT_ADDR);
+    uint8_t lyc = io_read(p, LYC_ADDR);
+    bus_set_ppu_deadline(p->mbus, now + dots_to_next_event(p, stat, lyc));
+    PROF_LEAVE();
+}
+
+void ppu_sync(ppu p) {
+    ppu_catch_up(p);
+}
+
+void ppu_set_frame_skip(ppu p, uint32_t render_interval) {
+    p->render_interval = render_interval;
+    dbg_log("PPU frame skip: render 1 of %u frames", (unsigned)render_interval);
+}
+
+// Lines composed from now on go to pixels (160x144, pitch_bytes per row)
+// instead of framebuffer; NULL switches back to the shade framebuffer.
+void ppu_set_rgba_target(ppu p, uint32_t *pixels, int pitch_bytes) {
+    p->rgba_pixels = pixels;
+    p->rgba_pitch = pitch_bytes / (int)sizeof(uint32_t);
+}
+
+void ppu_set_color_scheme(ppu p, const uint32_t colors[4]) {
+    memcpy(p->color_scheme, colors, sizeof(p->color_scheme));
+    for (int i = 0; i < PPU_PAL_COUNT; i++) {
+        p->palette_luts[i].reg_seen = -1;
+    }
+}
+
+ppu ppu_init(bus b) {
+    ppu p = (ppu)malloc(sizeof(struct PPU));
+    if (p == NULL) {
+        perror("[ERROR] Failed PPU allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    p->mbus = b;
+    p->io = bus_get_io(b);
+    p->mode = 0;
+    p->dot_counter = 0;
+    p->ly = 0;
+    p->frame_ready = false;
+    p->frame_rendered = false;
+    p->lyc_equal_last = false;
+    p->frame_counter = 0;
+    p->render_interval = 1;
+    p->render_this_frame = true;
+
+    ppu_init_luts();
+    p->oam_serial_seen = bus_get_oam_write_serial(b);
+    p->sprite_height_seen = 0;
+    p->lcdc_seen = -1;
+#ifdef EASYGB_PPU_FIFO
+    p->render_bgwin = NULL;
+    p->render_obj = NULL;
+    memset(&p->fifo, 0, sizeof(p->fifo));
+    p->mode3_dots = 0;
+    p->mode3_extra_dots = 0;
+    p->window_line = 0;
+    p->window_wy_hit = false;
+    p->window_on_line = false;
+#else
+    p->render_bgwin = render_bgwin_blank;
+    p->render_obj = render_obj_none;
+#endif
+    memset(p->line_sprite_count, 0, sizeof(p->line_sprite_count));
+    memset(p->bg_color_ids, 0, sizeof(p->bg_color_ids));
+    memset(p->framebuffer, 0, sizeof(p->framebuffer));
+    p->rgba_pixels = NULL;
+    p->rgba_pitch = SCREEN_WIDTH;
+    ppu_set_color_scheme(p, default_color_scheme);
+
+    write_io_ly(p, 0);
+    write_io_stat_mode(p, 0);
+    update_lyc_compare(p);
+
+    p->last_sync = bus_get_cycles(b);
+    bus_set_ppu_sync(b, ppu_catch_up, p);
+    bus_set_ppu_deadline(b, p->last_sync);
+
+    dbg_log("PPU init complete");
+    return p;
+}
+
+void ppu_destroy(ppu p) {
+    if (p == NULL) {
+        return;
+    }
+    bus_set_ppu_sync(p->mbus, NULL, NULL);
+    free(p);
+}
@@ -1,37 +1,134 @@
 #include "include/renderer.h"
 #include "include/bus.h"
+#include "include/debug.h"
 
 #ifdef EASYGB_USE_SDL
 #include <SDL2/SDL.h>
 #endif
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 enum {
     LCD_WIDTH = 160,
-    LCD_HEIGHT = 144
+    LCD_HEIGHT = 144,
+    UPLOAD_CALIBRATION_FRAMES = 60  // frames timed per upload path
+};
+
+// Speeds the -/= keys step through.
+static const double speed_steps[] = {
+    0.25, 0.5, 0.75, 1.0, 1.5, 2.0, 3.0, 4.0, 6.0, 8.0, 12.0, 16.0
+};
+
+// How composed frames reach the streaming texture: the PPU writes into the
+// locked texture itself, or into r->pixels which SDL_UpdateTexture copies.
+enum texture_upload {
+    UPLOAD_AUTO,
+    UPLOAD_LOCK,
+    UPLOAD_UPDATE
 };
 
 struct GBRenderer {
     uint8_t joypad_state;
-    int speed_multiplier;
+    double speed;               // RENDERER_SPEED_UNCAPPED or a multiple of real time
+    bool fast_forward;          // fast-forward key held
 #ifdef EASYGB_USE_SDL
     SDL_Window *window;
     SDL_Renderer *renderer;
     SDL_Texture *texture;
-    uint32_t pixels[LCD_WIDTH * LCD_HEIGHT];
+    bool has_color_scheme;
+    uint32_t color_scheme[4];
+
+    // UPLOAD_AUTO times both paths over the first frames, then keeps the
+    // faster one (locking is slower on some drivers).
+    enum texture_upload upload;
+    enum texture_upload active_upload;
+    bool texture_locked;
+    uint32_t calibration_frames;
+    uint64_t upload_ticks[3];
+    uint32_t pixels[LCD_WIDTH * LCD_HEIGHT];  // PPU target on the update path
 #endif
 };
 
+// EASYGB_SPEED is "uncapped" or a multiple of real time within the step
+// range; anything else leaves the default.
+static double speed_from_env(double fallback) {
+    const char *v = getenv("EASYGB_SPEED");
+    if (v == NULL || v[0] == '\0') {
+        return fallback;
+    }
+    if (strcmp(v, "uncapped") == 0) {
+        return RENDERER_SPEED_UNCAPPED;
+    }
+    double speed = atof(v);
+    size_t last = sizeof(speed_steps) / sizeof(speed_steps[0]) - 1u;
+    if (speed < speed_steps[0] || speed > speed_steps[last]) {
+        fprintf(stderr, "[WARN] Ignoring EASYGB_SPEED '%s' (uncapped or %.2f-%.0f)\n", v,
+                speed_steps[0], speed_steps[last]);
+        return fallback;
+    }
+    return speed;
+}
+
 #ifdef EASYGB_USE_SDL
 
-static inline uint32_t shade_to_rgba(uint8_t shade) {
-    switch (shade & 0x03u) {
-    case 0: return 0xE0F8D0FFu;
-    case 1: return 0x88C070FFu;
-    case 2: return 0x346856FFu;
-    default: return 0x081820FFu;
+// Next step above (dir > 0) or below the current speed; uncapped counts
+// as above every step.
+static double step_speed(double speed, int dir) {
+    size_t count = sizeof(speed_steps) / sizeof(speed_steps[0]);
+    if (speed == RENDERER_SPEED_UNCAPPED) {
+        return dir > 0 ? RENDERER_SPEED_UNCAPPED : speed_steps[count - 1u];
+    }
+    if (dir > 0) {
+        for (size_t i = 0; i < count; i++) {
+            if (speed_steps[i] > speed) {
+                return speed_steps[i];
+            }
+        }
+        return speed_steps[count - 1u];
+    }
+    for (size_t i = count; i-- > 0;) {
+        if (speed_steps[i] < speed) {
+            return speed_steps[i];
+        }
+    }
+    return speed_steps[0];
+}
+
+// Built-in color schemes for EASYGB_PALETTE, lightest shade first.
+static const struct {
+    const char *name;
+    uint32_t colors[4];
+} color_schemes[] = {
+    {"green", {0xE0F8D0FFu, 0x88C070FFu, 0x346856FFu, 0x081820FFu}},
+    {"gray",  {0xFFFFFFFFu, 0xAAAAAAFFu, 0x555555FFu, 0x000000FFu}},
+    {"pocket", {0xC4CFA1FFu, 0x8B956DFFu, 0x4D533CFFu, 0x1F1F1FFFu}}
+};
+
+// EASYGB_PALETTE is a scheme name or four RRGGBB values, lightest first
+// ("e0f8d0,88c070,346856,081820"). Colors are in the texture's RGBA8888.
+static bool parse_color_scheme(const char *spec, uint32_t out[4]) {
+    for (size_t i = 0; i < sizeof(color_schemes) / sizeof(color_schemes[0]); i++) {
+        if (strcmp(spec, color_schemes[i].name) == 0) {
+            memcpy(out, color_schemes[i].colors, sizeof(color_schemes[i].colors));
+            return true;
+        }
+    }
+
+    const char *cur = spec;
+    for (int i = 0; i < 4; i++) {
+        char *end = NULL;
+        unsigned long rgb = strtoul(cur, &end, 16);
+        if (end == cur || end - cur != 6) {
+            return false;
+        }
+        out[i] = ((uint32_t)rgb << 8) | 0xFFu;
+        if (*end != (i < 3 ? ',' : '\0')) {
+            return false;
+        }
+        cur = end + 1;
     }
+    return true;
 }
 
 gb_renderer renderer_init(int scale) {
@@ -50,7 +147,24 @@ gb_renderer renderer_init(int scale) {
         SDL_Quit();
         return NULL;
     }
-    r->speed_multiplier = 1;
+    r->speed = speed_from_env(1.0);
+
+    const char *palette = getenv("EASYGB_PALETTE");
+    if (palette != NULL && palette[0] != '\0') {
+        r->has_color_scheme = parse_color_scheme(palette, r->color_scheme);
+        if (!r->has_color_scheme) {
+            fprintf(stderr, "[WARN] Ignoring invalid EASYGB_PALETTE '%s'\n", palette);
+        }
+    }
+
+    const char *upload = getenv("EASYGB_TEXTURE_UPLOAD");
+    r->upload = UPLOAD_AUTO;
+    if (upload != NULL && strcmp(upload, "lock") == 0) {
+        r->upload = UPLOAD_LOCK;
+    } else if (upload != NULL && strcmp(upload, "update") == 0) {
+        r->upload = UPLOAD_UPDATE;
+    }
+    r->active_upload = r->upload == UPLOAD_UPDATE ? UPLOAD_UPDATE : UPLOAD_LOCK;
 
     r->window = SDL_CreateWindow(
         "EasyGB",
@@ -93,6 +207,9 @@ gb_renderer renderer_init(int scale) {
 
 void renderer_destroy(gb_renderer r) {
     if (r != NULL) {
+        if (r->texture != NULL && r->texture_locked) {
+            SDL_UnlockTexture(r->texture);
+        }
         if (r->texture != NULL) {
             SDL_DestroyTexture(r->texture);
         }
@@ -125,15 +242,27 @@ bool renderer_poll(gb_renderer r) {
             switch (event.key.keysym.sym) {
             case SDLK_1:
             case SDLK_KP_1:
-                r->speed_multiplier = 1;
+                r->speed = 1.0;
                 break;
             case SDLK_2:
             case SDLK_KP_2:
-                r->speed_multiplier = 2;
+                r->speed = 2.0;
                 break;
             case SDLK_3:
             case SDLK_KP_3:
-                r->speed_multiplier = 3;
+                r->speed = 3.0;
+                break;
+            case SDLK_0:
+            case SDLK_KP_0:
+                r->speed = r->speed == RENDERER_SPEED_UNCAPPED ? 1.0 : RENDERER_SPEED_UNCAPPED;
+                break;
+            case SDLK_MINUS:
+            case SDLK_KP_MINUS:
+                r->speed = step_speed(r->speed, -1);
+                break;
+            case SDLK_EQUALS:
+            case SDLK_KP_PLUS:
+                r->speed = step_speed(r->speed, 1);
                 break;
             default:
                 break;
@@ -155,6 +284,7 @@ bool renderer_poll(gb_renderer r) {
     if (keys[SDL_SCANCODE_BACKSPACE] || keys[SDL_SCANCODE_RSHIFT]) state |= JOY_SELECT;
 
     r->joypad_state = state;
+    r->fast_forward = keys[SDL_SCANCODE_TAB] != 0;
 
     return true;
 }
@@ -166,22 +296,85 @@ uint8_t renderer_get_joypad_state(gb_renderer r) {
     return r->joypad_state;
 }
 
-int renderer_get_speed_multiplier(gb_renderer r) {
-    if (r == NULL || r->speed_multiplier < 1) {
-        return 1;
+double renderer_get_speed(gb_renderer r) {
+    if (r == NULL) {
+        return 1.0;
+    }
+    return r->fast_forward ? RENDERER_SPEED_UNCAPPED : r->speed;
+}
+
+void renderer_show_speed(gb_renderer r, double achieved) {
+    double target = renderer_get_speed(r);
+    char title[64];
+    if (target == RENDERER_SPEED_UNCAPPED) {
+        snprintf(title, sizeof(title), "EasyGB - %.2fx (uncapped)", achieved);
+    } else {
+        snprintf(title, sizeof(title), "EasyGB - %.2fx (%gx)", achieved, target);
     }
-    return r->speed_multiplier;
+    SDL_SetWindowTitle(r->window, title);
 }
 
-void renderer_present(gb_renderer r, uint8_t framebuffer[144][160]) {
-    for (int y = 0; y < LCD_HEIGHT; y++) {
-        uint32_t *dst = &r->pixels[y * LCD_WIDTH];
-        for (int x = 0; x < LCD_WIDTH; x++) {
-            dst[x] = shade_to_rgba(framebuffer[y][x]);
+uint32_t *renderer_begin_frame(gb_renderer r, int *pitch_bytes) {
+    if (r->active_upload == UPLOAD_LOCK) {
+        void *pixels = NULL;
+        int pitch = 0;
+        uint64_t start = SDL_GetPerformanceCounter();
+        if (SDL_LockTexture(r->texture, NULL, &pixels, &pitch) == 0) {
+            r->upload_ticks[UPLOAD_LOCK] += SDL_GetPerformanceCounter() - start;
+            r->texture_locked = true;
+            *pitch_bytes = pitch;
+            return (uint32_t *)pixels;
         }
+
+        fprintf(stderr, "[WARN] SDL_LockTexture failed (%s), using SDL_UpdateTexture\n",
+                SDL_GetError());
+        r->upload = UPLOAD_UPDATE;
+        r->active_upload = UPLOAD_UPDATE;
+    }
+
+    *pitch_bytes = LCD_WIDTH * (int)sizeof(uint32_t);
+    return r->pixels;
+}
+
+static void finish_upload_calibration(gb_renderer r) {
+    if (r->upload != UPLOAD_AUTO) {
+        return;
+    }
+
+    r->calibration_frames++;
+    if (r->calibration_frames == UPLOAD_CALIBRATION_FRAMES) {
+        r->active_upload = UPLOAD_UPDATE;
+    } else if (r->calibration_frames == 2u * UPLOAD_CALIBRATION_FRAMES) {
+        r->upload = r->upload_ticks[UPLOAD_LOCK] <= r->upload_ticks[UPLOAD_UPDATE]
+                        ? UPLOAD_LOCK : UPLOAD_UPDATE;
+        r->active_upload = r->upload;
+        dbg_log("Renderer texture upload: %s (lock=%llu update=%llu ticks)",
+                r->upload == UPLOAD_LOCK ? "lock" : "update",
+                (unsigned long long)r->upload_ticks[UPLOAD_LOCK],
+                (unsigned long long)r->upload_ticks[UPLOAD_UPDATE]);
     }
+}
+
+bool renderer_get_color_scheme(gb_renderer r, uint32_t colors[4]) {
+    if (!r->has_color_scheme) {
+        return false;
+    }
+    memcpy(colors, r->color_scheme, sizeof(r->color_scheme));
+    return true;
+}
+
+void renderer_present(gb_renderer r) {
+    uint64_t start = SDL_GetPerformanceCounter();
+    if (r->texture_locked) {
+        SDL_UnlockTexture(r->texture);
+        r->texture_locked = false;
+        r->upload_ticks[UPLOAD_LOCK] += SDL_GetPerformanceCounter() - start;
+    } else {
+        SDL_UpdateTexture(r->texture, NULL, r->pixels, LCD_WIDTH * (int)sizeof(uint32_t));
+        r->upload_ticks[UPLOAD_UPDATE] += SDL_GetPerformanceCounter() - start;
+    }
+    finish_upload_calibration(r);
 
-    SDL_UpdateTexture(r->texture, NULL, r->pixels, LCD_WIDTH * (int)sizeof(uint32_t));
     SDL_RenderClear(r->renderer);
     SDL_RenderCopy(r->renderer, r->texture, NULL, NULL);
     SDL_RenderPresent(r->renderer);
@@ -196,7 +389,7 @@ gb_renderer renderer_init(int scale) {
         fprintf(stderr, "[ERROR] Renderer allocation failed\n");
         return NULL;
     }
-    r->speed_multiplier = 1;
+    r->speed = speed_from_env(RENDERER_SPEED_UNCAPPED);
     return r;
 }
 
@@ -214,14 +407,34 @@ uint8_t renderer_get_joypad_state(gb_renderer r) {
     return 0;
 }
 
-int renderer_get_speed_multiplier(gb_renderer r) {
+double renderer_get_speed(gb_renderer r) {
+    return r->speed;
+}
+
+void renderer_show_speed(gb_renderer r, double achieved) {
+    double target = r->speed;
+    if (target == RENDERER_SPEED_UNCAPPED) {
+        printf("[INFO] Speed: %.2fx (uncapped)\n", achieved);
+    } else {
+        printf("[INFO] Speed: %.2fx (%gx)\n", achieved, target);
+    }
+}
+
+// Nothing to show headless: the PPU keeps its shade framebuffer.
+uint32_t *renderer_begin_frame(gb_renderer r, int *pitch_bytes) {
+    (void)r;
+    *pitch_bytes = 0;
+    return NULL;
+}
+
+bool renderer_get_color_scheme(gb_renderer r, uint32_t colors[4]) {
     (void)r;
-    return 1;
+    (void)colors;
+    return false;
 }
 
-void renderer_present(gb_renderer r, uint8_t framebuffer[144][160]) {
+void renderer_present(gb_renderer r) {
     (void)r;
-    (void)framebuffer;
 }
 
 #endif
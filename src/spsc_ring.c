@@ -0,0 +1,93 @@
+#include "include/spsc_ring.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+spsc_ring spsc_ring_new(uint32_t min_items, size_t item_size) {
+    spsc_ring r = (spsc_ring)calloc(1, sizeof(struct SPSCRing));
+    if (r == NULL) {
+        perror("[ERROR] Failed ring buffer allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t capacity = 1u;
+    while (capacity < min_items) {
+        capacity <<= 1;
+    }
+
+    r->items = (uint8_t *)calloc(capacity, item_size);
+    if (r->items == NULL) {
+        perror("[ERROR] Failed ring buffer allocation!");
+        exit(EXIT_FAILURE);
+    }
+    r->item_size = item_size;
+    r->capacity = capacity;
+    r->mask = capacity - 1u;
+    atomic_init(&r->write_pos, 0u);
+    atomic_init(&r->read_pos, 0u);
+    return r;
+}
+
+void spsc_ring_free(spsc_ring r) {
+    if (r == NULL) {
+        return;
+    }
+    free(r->items);
+    free(r);
+}
+
+uint32_t spsc_ring_fill(spsc_ring r) {
+    uint32_t w = atomic_load_explicit(&r->write_pos, memory_order_acquire);
+    uint32_t rd = atomic_load_explicit(&r->read_pos, memory_order_acquire);
+    return w - rd;
+}
+
+uint32_t spsc_ring_space(spsc_ring r) {
+    return r->capacity - spsc_ring_fill(r);
+}
+
+// Copies count items starting at ring position pos, splitting at the wrap.
+static void copy_in(spsc_ring r, uint32_t pos, const uint8_t *src, size_t count) {
+    size_t first = r->capacity - (pos & r->mask);
+    if (first > count) {
+        first = count;
+    }
+    memcpy(&r->items[(pos & r->mask) * r->item_size], src, first * r->item_size);
+    memcpy(r->items, src + first * r->item_size, (count - first) * r->item_size);
+}
+
+static void copy_out(spsc_ring r, uint32_t pos, uint8_t *dst, size_t count) {
+    size_t first = r->capacity - (pos & r->mask);
+    if (first > count) {
+        first = count;
+    }
+    memcpy(dst, &r->items[(pos & r->mask) * r->item_size], first * r->item_size);
+    memcpy(dst + first * r->item_size, r->items, (count - first) * r->item_size);
+}
+
+size_t spsc_ring_write(spsc_ring r, const void *items, size_t count) {
+    uint32_t w = atomic_load_explicit(&r->write_pos, memory_order_relaxed);
+    uint32_t rd = atomic_load_explicit(&r->read_pos, memory_order_acquire);
+    size_t space = r->capacity - (w - rd);
+
+    if (count > space) {
+        count = space;
+    }
+    copy_in(r, w, (const uint8_t *)items, count);
+    atomic_store_explicit(&r->write_pos, w + (uint32_t)count, memory_order_release);
+    return count;
+}
+
+size_t spsc_ring_read(spsc_ring r, void *items, size_t count) {
+    uint32_t rd = atomic_load_explicit(&r->read_pos, memory_order_relaxed);
+    uint32_t w = atomic_load_explicit(&r->write_pos, memory_order_acquire);
+    size_t avail = w - rd;
+
+    if (count > avail) {
+        count = avail;
+    }
+    copy_out(r, rd, (uint8_t *)items, count);
+    atomic_store_explicit(&r->read_pos, rd + (uint32_t)count, memory_order_release);
+    return count;
+}
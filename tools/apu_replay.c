@@ -0,0 +1,89 @@
+// Feeds an APU register log (EASYGB_APU_LOG) straight into the APU, with
+// no CPU, bus traffic or PPU: what remains is channel synthesis, the step
+// buffers and the mixer. Writing the output to a WAV and comparing it with
+// one from another build shows any change sample for sample; without an
+// output it times the synthesis path.
+//
+//   bin/easygb_apu_replay LOG [SINK] [REPEAT]
+//
+// SINK is an apu_sink_open spec (wav:PATH, raw:PATH, null), by default
+// raw:/dev/null. REPEAT replays the log that many times and reports the
+// fastest pass. EASYGB_AUDIO_RATE/QUALITY apply as in the emulator.
+
+#include "../src/include/apu.h"
+#include "../src/include/apu_log.h"
+#include "tool_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum {
+    GB_CPU_HZ = 4194304
+};
+
+// One pass over the log; returns its wall time, or a negative value if
+// the log cannot be read.
+static double replay_once(const char *log_path, const char *spec, uint64_t *cycles,
+                          uint64_t *writes, uint64_t *frames) {
+    uint8_t regs[APU_LOG_REG_COUNT];
+    uint64_t start = 0;
+    apu_log_file log = apu_log_open(log_path, &start, regs);
+    if (log == NULL) {
+        return -1.0;
+    }
+
+    apu a = apu_init_detached(spec, regs, start);
+    struct apu_log_entry e;
+    uint64_t end = start;
+    *writes = 0;
+    *frames = 0;
+
+    double t0 = tool_now_sec();
+    while (apu_log_next(log, &e)) {
+        apu_replay(a, &e);
+        end = e.cycle;
+        if (e.kind == APU_LOG_END_FRAME) {
+            (*frames)++;
+        } else if (e.kind == APU_LOG_WRITE) {
+            (*writes)++;
+        }
+    }
+    apu_destroy(a);
+    double elapsed = tool_now_sec() - t0;
+
+    apu_log_close(log);
+    *cycles = end - start;
+    return elapsed;
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2 || argc > 4) {
+        fprintf(stderr, "Usage: %s LOG [SINK] [REPEAT]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    const char *spec = argc > 2 ? argv[2] : "raw:/dev/null";
+    int repeat = argc > 3 ? atoi(argv[3]) : 1;
+    if (repeat < 1) {
+        repeat = 1;
+    }
+
+    double best = 0.0;
+    uint64_t cycles = 0;
+    uint64_t writes = 0;
+    uint64_t frames = 0;
+    for (int i = 0; i < repeat; i++) {
+        double t = replay_once(argv[1], spec, &cycles, &writes, &frames);
+        if (t < 0.0) {
+            return EXIT_FAILURE;
+        }
+        if (i == 0 || t < best) {
+            best = t;
+        }
+    }
+
+    double emulated = (double)cycles / GB_CPU_HZ;
+    printf("%llu writes, %llu frames, %.1f s of audio in %.3f s (%.0fx real time)\n",
+           (unsigned long long)writes, (unsigned long long)frames, emulated, best,
+           best > 0.0 ? emulated / best : 0.0);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,126 @@
+// Measures the CPU cost of the audio output stage (step synthesis at each
+// resampler quality tier plus the mixer) for a range of host sample rates.
+// The workload is synthetic but shaped like busy game audio: two square
+// channels, a wave channel stepping every 32 clocks and fast noise.
+//
+//   bin/easygb_audio_bench [seconds of emulated audio per run, default 20]
+
+#include "../src/include/apu_mix.h"
+#include "../src/include/blip.h"
+#include "tool_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+enum {
+    GB_CPU_HZ = 4194304,
+    FRAME_CYCLES = 70224,
+    READ_CHUNK = APU_MIX_MAX_BLOCK
+};
+
+struct bench_channel {
+    uint32_t period;            // clocks between level changes
+    uint32_t next;
+    int      level;
+    uint32_t lfsr;              // noise only
+};
+
+static const int bench_rates[] = {22050, 44100, 48000, 96000};
+
+static volatile int32_t bench_sink;     // keeps the mixed output observable
+
+// Emits every level change of one channel inside [0, FRAME_CYCLES).
+static void bench_channel_frame(blip_buffer b, struct bench_channel *ch, bool noise) {
+    while (ch->next < FRAME_CYCLES) {
+        int level;
+        if (noise) {
+            uint32_t bit = (ch->lfsr ^ (ch->lfsr >> 1)) & 1u;
+            ch->lfsr = (ch->lfsr >> 1) | (bit << 14);
+            level = (ch->lfsr & 1u) != 0u ? -12 : 12;
+        } else {
+            level = ch->level > 0 ? -15 : 15;
+        }
+        blip_add_delta(b, ch->next, level - ch->level);
+        ch->level = level;
+        ch->next += ch->period;
+    }
+    ch->next -= FRAME_CYCLES;
+}
+
+// Returns nanoseconds per stereo output sample for one tier and rate.
+static double bench_run(enum blip_quality quality, int rate, double seconds) {
+    blip_buffer blip[APU_MIX_CHANNELS];
+    struct bench_channel ch[APU_MIX_CHANNELS] = {
+        {.period = 1196},       // ~440 Hz duty flips
+        {.period = 892},
+        {.period = 32},         // wave sample steps
+        {.period = 40, .lfsr = 0x7FFFu}
+    };
+    static int32_t chan_block[APU_MIX_CHANNELS][READ_CHUNK];
+    static int16_t out[READ_CHUNK * 2];
+    const int32_t *const chan[APU_MIX_CHANNELS] = {
+        chan_block[0], chan_block[1], chan_block[2], chan_block[3]
+    };
+    struct apu_mix_gains gains;
+    struct apu_hpf hpf;
+    long frames = (long)(seconds * GB_CPU_HZ / FRAME_CYCLES);
+    long samples = 0;
+
+    for (int c = 0; c < APU_MIX_CHANNELS; c++) {
+        blip[c] = blip_new(GB_CPU_HZ, rate, quality);
+    }
+    apu_mix_set_gains(&gains, 0x77u, 0xFFu);
+    apu_hpf_init(&hpf, rate);
+
+    double start = tool_now_sec();
+    for (long f = 0; f < frames; f++) {
+        for (int c = 0; c < APU_MIX_CHANNELS; c++) {
+            bench_channel_frame(blip[c], &ch[c], c == 3);
+            blip_end_frame(blip[c], FRAME_CYCLES);
+        }
+        int n;
+        while ((n = blip[0]->avail) > 0) {
+            if (n > READ_CHUNK) {
+                n = READ_CHUNK;
+            }
+            for (int c = 0; c < APU_MIX_CHANNELS; c++) {
+                blip_read_samples(blip[c], chan_block[c], n);
+            }
+            apu_mix_block(&gains, &hpf, chan, out, n);
+            bench_sink += out[n - 1];
+            samples += n;
+        }
+    }
+    double elapsed = tool_now_sec() - start;
+
+    for (int c = 0; c < APU_MIX_CHANNELS; c++) {
+        blip_free(blip[c]);
+    }
+    return samples > 0 ? elapsed * 1e9 / (double)samples : 0.0;
+}
+
+int main(int argc, char **argv) {
+    double seconds = argc > 1 ? atof(argv[1]) : 20.0;
+    if (seconds <= 0.0) {
+        seconds = 20.0;
+    }
+
+    printf("audio output stage, %.0f s emulated per run, %s mixer\n", seconds, apu_mix_kernel_name());
+    printf("%-8s %7s %12s %12s\n", "quality", "rate", "ns/sample", "x realtime");
+    for (int q = 0; q < BLIP_QUALITY_COUNT; q++) {
+        for (size_t r = 0; r < sizeof(bench_rates) / sizeof(bench_rates[0]); r++) {
+            double ns = 0.0;
+            // Best of three, to keep scheduler noise out of the comparison.
+            for (int run = 0; run < 3; run++) {
+                double t = bench_run((enum blip_quality)q, bench_rates[r], seconds);
+                if (run == 0 || t < ns) {
+                    ns = t;
+                }
+            }
+            double realtime = ns > 0.0 ? 1e9 / (ns * bench_rates[r]) : 0.0;
+            printf("%-8s %7d %12.1f %12.0f\n", blip_quality_name((enum blip_quality)q),
+                   bench_rates[r], ns, realtime);
+        }
+    }
+    return 0;
+}
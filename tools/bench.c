@@ -0,0 +1,308 @@
+// Whole-emulator throughput benchmark: runs each ROM headless for a fixed
+// number of emulated cycles, several times, and reports emulated MHz,
+// frames/s and instructions/s (median and p95 over the timed trials) with
+// the share of host time spent in the CPU, PPU, APU and timer.
+//
+//   bin/easygb_bench [--cycles N] [--trials N] [--warmup N] [--json PATH] ROM...
+//
+// Every trial starts from the post-boot state at 0100h (the boot ROM would
+// be the same few seconds of work for every ROM), so all trials of a ROM
+// execute the same instructions. Frames are composed (as in a window at 1x) and audio
+// is synthesized into raw:/dev/null. Component shares come from SIGPROF
+// sampling of the EASYGB_PROFILE zone markers; the build target enables
+// them, at a cost of a few stores per instruction.
+
+#include "../src/include/prof.h"
+#include "tool_machine.h"
+#include "tool_util.h"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+enum {
+    GB_CPU_HZ = 4194304,
+    BENCH_MAX_TRIALS = 100,
+    PROF_SAMPLE_US = 1000
+};
+
+static const char *zone_names[PROF_ZONE_COUNT] = {"cpu", "ppu", "apu", "timer"};
+
+static volatile sig_atomic_t zone_samples[PROF_ZONE_COUNT];
+
+struct bench_options {
+    uint64_t cycles;            // per trial
+    int trials;
+    int warmup;
+    const char *json_path;
+};
+
+struct bench_trial {
+    double seconds;
+    uint64_t cycles;
+    uint64_t frames;
+    uint64_t instructions;
+};
+
+struct bench_result {
+    const char *rom;
+    int trials;
+    struct bench_trial trial[BENCH_MAX_TRIALS];
+    double median_s;
+    double p95_s;
+    uint64_t samples[PROF_ZONE_COUNT];
+};
+
+static void on_sigprof(int sig) {
+    (void)sig;
+    zone_samples[prof_zone]++;
+}
+
+static void set_sampling(bool on) {
+    struct itimerval it;
+    memset(&it, 0, sizeof(it));
+    if (on) {
+        it.it_interval.tv_usec = PROF_SAMPLE_US;
+        it.it_value.tv_usec = PROF_SAMPLE_US;
+    }
+    setitimer(ITIMER_PROF, &it, NULL);
+}
+
+// Runs a fresh machine for cycles; only the run loop is timed.
+static struct bench_trial bench_trial_run(cartridge cart, uint64_t cycles, bool sample) {
+    struct tool_machine m;
+    tool_machine_init(&m, cart, true, "raw:/dev/null");
+    struct bench_trial t = {0};
+
+    uint64_t end = bus_get_cycles(m.b) + cycles;
+    set_sampling(sample);
+    double start = tool_now_sec();
+    while (bus_get_cycles(m.b) < end) {
+        cpu_step(m.c);
+        t.instructions++;
+        if (m.p->frame_ready) {
+            m.p->frame_ready = false;
+            apu_end_frame(m.a);
+            t.frames++;
+        }
+    }
+    t.seconds = tool_now_sec() - start;
+    set_sampling(false);
+    t.cycles = bus_get_cycles(m.b) - (end - cycles);
+
+    tool_machine_free(&m);
+    return t;
+}
+
+// Nearest-rank percentile of the trial times.
+static double trial_percentile(const struct bench_result *r, double pct) {
+    double s[BENCH_MAX_TRIALS];
+    for (int i = 0; i < r->trials; i++) {
+        s[i] = r->trial[i].seconds;
+    }
+    qsort(s, (size_t)r->trials, sizeof(s[0]), tool_compare_double);
+    int rank = (int)(pct / 100.0 * r->trials + 0.999999);
+    if (rank < 1) {
+        rank = 1;
+    }
+    return s[rank - 1];
+}
+
+static double per_second(uint64_t count, double seconds) {
+    return seconds > 0.0 ? (double)count / seconds : 0.0;
+}
+
+static bool bench_rom(const char *path, const struct bench_options *opts, struct bench_result *r) {
+    cartridge cart = tool_cart_load(path);
+    if (cart == NULL) {
+        return false;
+    }
+    memset(r, 0, sizeof(*r));
+    r->rom = path;
+
+    for (int i = 0; i < opts->warmup; i++) {
+        bench_trial_run(cart, opts->cycles, false);
+    }
+    for (int z = 0; z < PROF_ZONE_COUNT; z++) {
+        zone_samples[z] = 0;
+    }
+    for (int i = 0; i < opts->trials; i++) {
+        r->trial[i] = bench_trial_run(cart, opts->cycles, true);
+    }
+    r->trials = opts->trials;
+    for (int z = 0; z < PROF_ZONE_COUNT; z++) {
+        r->samples[z] = (uint64_t)zone_samples[z];
+    }
+    r->median_s = trial_percentile(r, 50.0);
+    r->p95_s = trial_percentile(r, 95.0);
+
+    tool_cart_free(cart);
+    return true;
+}
+
+static void print_result(const struct bench_result *r) {
+    const struct bench_trial *t = &r->trial[0];
+    uint64_t total = 0;
+    for (int z = 0; z < PROF_ZONE_COUNT; z++) {
+        total += r->samples[z];
+    }
+
+    printf("%s\n", r->rom);
+    printf("  %.2f MHz median (%.1fx real time), %.2f MHz p95, over %d trials of %llu cycles\n",
+           (double)t->cycles / r->median_s / 1e6, (double)t->cycles / r->median_s / GB_CPU_HZ,
+           (double)t->cycles / r->p95_s / 1e6, r->trials, (unsigned long long)t->cycles);
+    printf("  %.0f frames/s, %.2f M instructions/s\n", per_second(t->frames, r->median_s),
+           per_second(t->instructions, r->median_s) / 1e6);
+    printf("  time:");
+    for (int z = 0; z < PROF_ZONE_COUNT; z++) {
+        printf(" %s %.1f%%", zone_names[z],
+               total != 0u ? 100.0 * (double)r->samples[z] / (double)total : 0.0);
+    }
+    printf(" (%llu samples)\n", (unsigned long long)total);
+}
+
+static void write_json(FILE *f, const struct bench_options *opts, const struct bench_result *res,
+                       int count) {
+    fprintf(f, "{\n  \"cycles_per_trial\": %llu,\n  \"trials\": %d,\n  \"warmup\": %d,\n",
+            (unsigned long long)opts->cycles, opts->trials, opts->warmup);
+    fprintf(f, "  \"roms\": [\n");
+    for (int i = 0; i < count; i++) {
+        const struct bench_result *r = &res[i];
+        const struct bench_trial *t = &r->trial[0];
+        uint64_t total = 0;
+        for (int z = 0; z < PROF_ZONE_COUNT; z++) {
+            total += r->samples[z];
+        }
+
+        fprintf(f, "    {\n      \"rom\": \"");
+        for (const char *c = r->rom; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                fputc('\\', f);
+            }
+            fputc(*c, f);
+        }
+        fprintf(f, "\",\n");
+        fprintf(f, "      \"median_s\": %.6f,\n      \"p95_s\": %.6f,\n", r->median_s, r->p95_s);
+        fprintf(f, "      \"median_mhz\": %.3f,\n      \"p95_mhz\": %.3f,\n",
+                (double)t->cycles / r->median_s / 1e6, (double)t->cycles / r->p95_s / 1e6);
+        fprintf(f, "      \"frames\": %llu,\n      \"frames_per_s\": %.1f,\n",
+                (unsigned long long)t->frames, per_second(t->frames, r->median_s));
+        fprintf(f, "      \"instructions\": %llu,\n      \"instructions_per_s\": %.0f,\n",
+                (unsigned long long)t->instructions,
+                per_second(t->instructions, r->median_s));
+        fprintf(f, "      \"trial_s\": [");
+        for (int k = 0; k < r->trials; k++) {
+            fprintf(f, "%s%.6f", k != 0 ? ", " : "", r->trial[k].seconds);
+        }
+        fprintf(f, "],\n      \"time_share\": {");
+        for (int z = 0; z < PROF_ZONE_COUNT; z++) {
+            fprintf(f, "%s\"%s\": %.4f", z != 0 ? ", " : "", zone_names[z],
+                    total != 0u ? (double)r->samples[z] / (double)total : 0.0);
+        }
+        fprintf(f, "},\n      \"profile_samples\": %llu\n    }%s\n", (unsigned long long)total,
+                i + 1 < count ? "," : "");
+    }
+    fprintf(f, "  ]\n}\n");
+}
+
+static bool parse_int_option(const char *name, const char *text, long long min, long long max,
+                             long long *out) {
+    char *end = NULL;
+    long long v = strtoll(text, &end, 10);
+    if (end == text || *end != '\0' || v < min || v > max) {
+        fprintf(stderr, "%s must be %lld-%lld\n", name, min, max);
+        return false;
+    }
+    *out = v;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    struct bench_options opts = {
+        .cycles = 30ull * GB_CPU_HZ,
+        .trials = 5,
+        .warmup = 1,
+        .json_path = NULL
+    };
+    int first_rom = argc;
+
+    for (int i = 1; i < argc; i++) {
+        long long v = 0;
+        if (strncmp(argv[i], "--", 2) != 0) {
+            first_rom = i;
+            break;
+        }
+        if (i + 1 >= argc) {
+            fprintf(stderr, "%s needs a value\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--cycles") == 0) {
+            if (!parse_int_option("--cycles", argv[++i], 1, 1ll << 40, &v)) {
+                return EXIT_FAILURE;
+            }
+            opts.cycles = (uint64_t)v;
+        } else if (strcmp(argv[i], "--trials") == 0) {
+            if (!parse_int_option("--trials", argv[++i], 1, BENCH_MAX_TRIALS, &v)) {
+                return EXIT_FAILURE;
+            }
+            opts.trials = (int)v;
+        } else if (strcmp(argv[i], "--warmup") == 0) {
+            if (!parse_int_option("--warmup", argv[++i], 0, 100, &v)) {
+                return EXIT_FAILURE;
+            }
+            opts.warmup = (int)v;
+        } else if (strcmp(argv[i], "--json") == 0) {
+            opts.json_path = argv[++i];
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (first_rom >= argc) {
+        fprintf(stderr, "Usage: %s [--cycles N] [--trials N] [--warmup N] [--json PATH] ROM...\n",
+                argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_sigprof;
+    sa.sa_flags = SA_RESTART;
+    sigaction(SIGPROF, &sa, NULL);
+
+    int count = argc - first_rom;
+    struct bench_result *res = (struct bench_result *)calloc((size_t)count, sizeof(*res));
+    if (res == NULL) {
+        perror("[ERROR] Failed benchmark allocation!");
+        exit(EXIT_FAILURE);
+    }
+    for (int i = 0; i < count; i++) {
+        if (!bench_rom(argv[first_rom + i], &opts, &res[i])) {
+            free(res);
+            return EXIT_FAILURE;
+        }
+    }
+
+    printf("\n");
+    for (int i = 0; i < count; i++) {
+        print_result(&res[i]);
+    }
+
+    if (opts.json_path != NULL) {
+        FILE *f = strcmp(opts.json_path, "-") == 0 ? stdout : fopen(opts.json_path, "w");
+        if (f == NULL) {
+            perror("[ERROR] Unable to write benchmark JSON");
+            free(res);
+            return EXIT_FAILURE;
+        }
+        write_json(f, &opts, res, count);
+        if (f != stdout) {
+            fclose(f);
+            printf("\nJSON written to %s\n", opts.json_path);
+        }
+    }
+    free(res);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,415 @@
+// Microbenchmarks for the emulator's hot paths, on a synthetic machine
+// (an in-memory MBC1 cartridge, no ROM file): bus_read8/bus_write8 per
+// memory region, every opcode and CB opcode through execute_opcode and
+// execute_cb, PPU line composition for representative LCDC setups, and
+// the APU output mixer. Whole-ROM runs (make bench) show how fast a game
+// goes; these show which path moved when that number changes.
+//
+//   bin/easygb_microbench [bus] [op] [cb] [ppu] [mix]
+//
+// With no arguments every group runs. Each case is calibrated to at least
+// a millisecond per run, then run MB_RUNS times; the table shows the
+// median ns per operation with the 10th-90th percentile spread.
+
+#include "../src/include/apu_mix.h"
+#include "../src/include/opcodes.h"
+#include "tool_machine.h"
+#include "tool_util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    MB_RUNS = 11,
+    MB_MIN_RUN_NS = 1000000,
+    MB_ROM_KIB = 64,
+    MB_RAM_KIB = 8,
+    MB_CART_TYPE = 0x03,        // MBC1+RAM+BATTERY
+    MB_CODE_ADDR = 0xC000,      // opcodes run from WRAM
+    MB_LINE = 64,               // scanline the PPU cases compose
+    MB_MIX_BLOCK = APU_MIX_MAX_BLOCK
+};
+
+typedef void (*mb_fn)(void *ctx, uint64_t iters);
+
+struct mb_stats {
+    double median_ns;
+    double p10_ns;
+    double p90_ns;
+};
+
+static volatile uint32_t mb_sink;       // keeps results observable
+
+// ns per operation, where one fn iteration performs ops_per_iter operations.
+static struct mb_stats mb_measure(mb_fn fn, void *ctx, double ops_per_iter) {
+    uint64_t iters = 16;
+    for (;;) {
+        uint64_t t0 = tool_now_ns();
+        fn(ctx, iters);
+        if (tool_now_ns() - t0 >= MB_MIN_RUN_NS || iters >= (1ull << 32)) {
+            break;
+        }
+        iters *= 2u;
+    }
+
+    double ns[MB_RUNS];
+    for (int r = 0; r < MB_RUNS; r++) {
+        uint64_t t0 = tool_now_ns();
+        fn(ctx, iters);
+        ns[r] = (double)(tool_now_ns() - t0) / ((double)iters * ops_per_iter);
+    }
+    qsort(ns, MB_RUNS, sizeof(ns[0]), tool_compare_double);
+
+    struct mb_stats s = {ns[MB_RUNS / 2], ns[MB_RUNS / 10], ns[MB_RUNS - 1 - MB_RUNS / 10]};
+    return s;
+}
+
+static void mb_report(const char *name, struct mb_stats s) {
+    printf("  %-34s %8.2f ns  (%.2f-%.2f)\n", name, s.median_ns, s.p10_ns, s.p90_ns);
+}
+
+static inline uint32_t mb_rand(uint32_t *state) {
+    *state = *state * 1664525u + 1013904223u;
+    return *state >> 8;
+}
+
+// --- synthetic machine ---
+
+static cartridge mb_cart_new(void) {
+    cartridge cart = (cartridge)malloc(sizeof(struct cartridge));
+    header head = (header)calloc(1, sizeof(struct header));
+    uint8_t *rom = (uint8_t *)malloc(KIB((size_t)MB_ROM_KIB));
+    if (cart == NULL || head == NULL || rom == NULL) {
+        perror("[ERROR] Failed microbenchmark allocation!");
+        exit(EXIT_FAILURE);
+    }
+
+    uint32_t seed = 1;
+    for (size_t i = 0; i < KIB((size_t)MB_ROM_KIB); i++) {
+        rom[i] = (uint8_t)mb_rand(&seed);
+    }
+    memcpy(head->title, "MICROBENCH", 10);
+    head->cart_type = MB_CART_TYPE;
+    head->rom_size = MB_ROM_KIB;
+    head->ram_size = MB_RAM_KIB;
+    cart->raw_cart = rom;
+    cart->head = head;
+    return cart;
+}
+
+// --- bus ---
+
+struct mb_bus_case {
+    const char *name;
+    uint16_t base;
+    uint16_t mask;              // addresses base + (i & mask)
+};
+
+struct mb_bus_ctx {
+    bus b;
+    uint16_t base;
+    uint16_t mask;
+};
+
+static void mb_bus_read(void *ctx, uint64_t iters) {
+    struct mb_bus_ctx *x = (struct mb_bus_ctx *)ctx;
+    uint32_t acc = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        acc += bus_read8(x->b, (uint16_t)(x->base + (i & x->mask)));
+    }
+    mb_sink = acc;
+}
+
+static void mb_bus_write(void *ctx, uint64_t iters) {
+    struct mb_bus_ctx *x = (struct mb_bus_ctx *)ctx;
+    for (uint64_t i = 0; i < iters; i++) {
+        bus_write8(x->b, (uint16_t)(x->base + (i & x->mask)), (uint8_t)i);
+    }
+}
+
+static void mb_group_bus(struct tool_machine *m) {
+    static const struct mb_bus_case reads[] = {
+        {"read ROM bank 0", 0x0000, 0x3FFF},
+        {"read ROM bank N", 0x4000, 0x3FFF},
+        {"read VRAM", 0x8000, 0x1FFF},
+        {"read cartridge RAM", 0xA000, 0x1FFF},
+        {"read WRAM", 0xC000, 0x1FFF},
+        {"read echo RAM", 0xE000, 0x0FFF},
+        {"read OAM", 0xFE00, 0x007F},
+        {"read IO joypad/serial/timer", 0xFF00, 0x0007},
+        {"read IO APU (FF10-FF17)", 0xFF10, 0x0007},
+        {"read IO PPU (FF40-FF47)", 0xFF40, 0x0007},
+        {"read HRAM", 0xFF80, 0x003F}
+    };
+    static const struct mb_bus_case writes[] = {
+        {"write MBC ROM bank select", 0x2000, 0x001F},
+        {"write VRAM", 0x8000, 0x1FFF},
+        {"write cartridge RAM", 0xA000, 0x1FFF},
+        {"write WRAM", 0xC000, 0x1FFF},
+        {"write OAM", 0xFE00, 0x007F},
+        {"write IO APU wave RAM", 0xFF30, 0x000F},
+        {"write IO PPU (FF48-FF4B)", 0xFF48, 0x0003},
+        {"write HRAM", 0xFF80, 0x003F}
+    };
+
+    printf("bus (ns per access)\n");
+    for (size_t i = 0; i < sizeof(reads) / sizeof(reads[0]); i++) {
+        struct mb_bus_ctx x = {m->b, reads[i].base, reads[i].mask};
+        mb_report(reads[i].name, mb_measure(mb_bus_read, &x, 1.0));
+    }
+    for (size_t i = 0; i < sizeof(writes) / sizeof(writes[0]); i++) {
+        struct mb_bus_ctx x = {m->b, writes[i].base, writes[i].mask};
+        mb_report(writes[i].name, mb_measure(mb_bus_write, &x, 1.0));
+    }
+    bus_write8(m->b, 0x2000, 0x01);
+}
+
+// --- opcodes ---
+
+struct mb_op_ctx {
+    cpu c;
+    uint8_t op;
+    int kind;                   // 0: state reset only, 1: opcode, 2: CB opcode
+};
+
+// Same state before every run: operands at PC read 80 FF (so a8/a16
+// point at HRAM), and BC, DE, HL and SP point into WRAM.
+static inline void mb_cpu_reset(cpu c) {
+    c->PC = MB_CODE_ADDR;
+    c->SP = 0xDFF0;
+    c->A = 0x3C;
+    c->F = 0x00;
+    c->B = 0xC1;
+    c->C = 0x80;
+    c->D = 0xC2;
+    c->E = 0x00;
+    c->H = 0xC1;
+    c->L = 0x00;
+    c->halted = false;
+    c->ime = false;
+    c->ime_pending = 0;
+    c->cycles = 0;
+}
+
+static void mb_op_run(void *ctx, uint64_t iters) {
+    struct mb_op_ctx *x = (struct mb_op_ctx *)ctx;
+    cpu c = x->c;
+    for (uint64_t i = 0; i < iters; i++) {
+        mb_cpu_reset(c);
+        if (x->kind == 1) {
+            execute_opcode(c, x->op);
+        } else if (x->kind == 2) {
+            execute_cb(c, x->op);
+        }
+    }
+    mb_sink = c->A;
+}
+
+static void mb_group_ops(struct tool_machine *m, bool cb) {
+    bus_write8(m->b, MB_CODE_ADDR, 0x80);
+    bus_write8(m->b, MB_CODE_ADDR + 1, 0xFF);
+
+    struct mb_op_ctx base = {m->c, 0, 0};
+    double overhead = mb_measure(mb_op_run, &base, 1.0).median_ns;
+    printf("%s (ns per opcode, less %.2f ns of state reset)\n",
+           cb ? "CB opcodes" : "opcodes", overhead);
+
+    for (int op = 0; op < 256; op++) {
+        char name[8];
+        if (cb) {
+            snprintf(name, sizeof(name), "CB %02X", op);
+        } else {
+            if (opcodes[op].handler == NULL || op == 0xCB) {
+                continue;
+            }
+            snprintf(name, sizeof(name), "%02X", op);
+        }
+        struct mb_op_ctx x = {m->c, (uint8_t)op, cb ? 2 : 1};
+        struct mb_stats s = mb_measure(mb_op_run, &x, 1.0);
+        s.median_ns -= overhead;
+        s.p10_ns -= overhead;
+        s.p90_ns -= overhead;
+        mb_report(name, s);
+    }
+}
+
+// --- PPU ---
+
+struct mb_ppu_case {
+    const char *name;
+    uint8_t lcdc;
+    uint8_t wx;
+    int sprites;                // on MB_LINE
+    bool rgba;
+};
+
+static void mb_ppu_run(void *ctx, uint64_t iters) {
+    ppu p = (ppu)ctx;
+    for (uint64_t i = 0; i < iters; i++) {
+        ppu_render_scanline(p, MB_LINE);
+    }
+    mb_sink = p->framebuffer[MB_LINE][80];
+}
+
+static void mb_ppu_setup(struct tool_machine *m) {
+    uint32_t seed = 7;
+    bus_write8(m->b, 0xFF40, 0x00);                     // LCD off for setup
+    for (uint16_t a = 0x8000; a < 0x9800u; a++) {
+        bus_write8(m->b, a, (uint8_t)mb_rand(&seed));
+    }
+    for (uint16_t a = 0x9800; a < 0xA000u; a++) {
+        bus_write8(m->b, a, (uint8_t)mb_rand(&seed));
+    }
+    bus_write8(m->b, 0xFF42, 5);                        // SCY
+    bus_write8(m->b, 0xFF43, 3);                        // SCX: fine scroll
+    bus_write8(m->b, 0xFF47, 0xE4);
+    bus_write8(m->b, 0xFF48, 0xD2);
+    bus_write8(m->b, 0xFF49, 0x1B);
+    bus_write8(m->b, 0xFF4A, 0);                        // WY
+}
+
+// count sprites covering MB_LINE, spread across the line with mixed flags;
+// the rest of OAM off screen.
+static void mb_ppu_sprites(struct tool_machine *m, int count) {
+    for (int i = 0; i < 40; i++) {
+        uint16_t at = (uint16_t)(0xFE00 + i * 4);
+        bool on = i < count;
+        bus_write8(m->b, at, on ? (uint8_t)(MB_LINE + 16 - (i % 8)) : 0);
+        bus_write8(m->b, (uint16_t)(at + 1), (uint8_t)(8 + i * 15));
+        bus_write8(m->b, (uint16_t)(at + 2), (uint8_t)(i * 3));
+        bus_write8(m->b, (uint16_t)(at + 3), (uint8_t)((i & 3) << 5 | (i & 4) << 5));
+    }
+}
+
+static void mb_group_ppu(struct tool_machine *m) {
+    static const struct mb_ppu_case cases[] = {
+        {"BG, 8000 tiles", 0x91, 0, 0, false},
+        {"BG, 8800 signed tiles", 0x81, 0, 0, false},
+        {"BG to RGBA target", 0x91, 0, 0, true},
+        {"BG + window from x=80", 0xB1, 87, 0, false},
+        {"BG + full-line window", 0xB1, 7, 0, false},
+        {"BG + 10 OBJ 8x8", 0x93, 0, 10, false},
+        {"BG + 10 OBJ 8x16", 0x97, 0, 10, false},
+        {"BG + window + 10 OBJ", 0xB3, 87, 10, false},
+        {"BG + window + 10 OBJ to RGBA", 0xB3, 87, 10, true}
+    };
+    static uint32_t rgba[144 * 160];
+    const uint32_t scheme[4] = {0xE0F8D0FFu, 0x88C070FFu, 0x346856FFu, 0x081820FFu};
+    double bg = 0.0;
+    double bg_win = 0.0;
+    double bg_obj = 0.0;
+
+    mb_ppu_setup(m);
+    ppu_set_color_scheme(m->p, scheme);
+    printf("PPU (ns per composed line)\n");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        const struct mb_ppu_case *k = &cases[i];
+        mb_ppu_sprites(m, k->sprites);
+        bus_write8(m->b, 0xFF4B, k->wx);
+        bus_write8(m->b, 0xFF40, k->lcdc);
+        ppu_set_rgba_target(m->p, k->rgba ? rgba : NULL, 160 * (int)sizeof(uint32_t));
+
+        struct mb_stats s = mb_measure(mb_ppu_run, m->p, 1.0);
+        mb_report(k->name, s);
+        if (i == 0) {
+            bg = s.median_ns;
+        } else if (i == 3) {
+            bg_win = s.median_ns;
+        } else if (i == 5) {
+            bg_obj = s.median_ns;
+        }
+    }
+    ppu_set_rgba_target(m->p, NULL, 0);
+    printf("  %-34s %8.2f ns\n", "window share (half line)", bg_win - bg);
+    printf("  %-34s %8.2f ns\n", "OBJ share (10 sprites)", bg_obj - bg);
+}
+
+// --- APU mixer ---
+
+struct mb_mix_ctx {
+    struct apu_mix_gains gains;
+    struct apu_hpf hpf;
+    int32_t chan[APU_MIX_CHANNELS][MB_MIX_BLOCK];
+    int16_t out[MB_MIX_BLOCK * 2];
+};
+
+static void mb_mix_run(void *ctx, uint64_t iters) {
+    struct mb_mix_ctx *x = (struct mb_mix_ctx *)ctx;
+    const int32_t *const chan[APU_MIX_CHANNELS] = {x->chan[0], x->chan[1], x->chan[2], x->chan[3]};
+    for (uint64_t i = 0; i < iters; i++) {
+        apu_mix_block(&x->gains, &x->hpf, chan, x->out, MB_MIX_BLOCK);
+    }
+    mb_sink = (uint32_t)x->out[0];
+}
+
+static void mb_group_mix(void) {
+    struct mb_mix_ctx *x = (struct mb_mix_ctx *)calloc(1, sizeof(*x));
+    if (x == NULL) {
+        perror("[ERROR] Failed microbenchmark allocation!");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t seed = 3;
+    for (int c = 0; c < APU_MIX_CHANNELS; c++) {
+        for (int i = 0; i < MB_MIX_BLOCK; i++) {
+            x->chan[c][i] = (int32_t)(mb_rand(&seed) & 0xFFFFu) - 0x8000;
+        }
+    }
+    apu_hpf_init(&x->hpf, 48000);
+
+    printf("APU mixer, %s kernel (ns per stereo sample)\n", apu_mix_kernel_name());
+    apu_mix_set_gains(&x->gains, 0x77u, 0xFFu);
+    mb_report("all channels both sides", mb_measure(mb_mix_run, x, MB_MIX_BLOCK));
+    apu_mix_set_gains(&x->gains, 0x33u, 0x21u);
+    mb_report("two channels, split", mb_measure(mb_mix_run, x, MB_MIX_BLOCK));
+    free(x);
+}
+
+static bool group_selected(int argc, char **argv, const char *group) {
+    if (argc < 2) {
+        return true;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], group) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char **argv) {
+    static const char *groups[] = {"bus", "op", "cb", "ppu", "mix"};
+    for (int i = 1; i < argc; i++) {
+        bool known = false;
+        for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++) {
+            known = known || strcmp(argv[i], groups[g]) == 0;
+        }
+        if (!known) {
+            fprintf(stderr, "Usage: %s [bus] [op] [cb] [ppu] [mix]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    cartridge cart = mb_cart_new();
+    struct tool_machine m;
+    tool_machine_init(&m, cart, true, "null");
+    bus_write8(m.b, 0x0000, 0x0A);                      // cartridge RAM on
+    if (group_selected(argc, argv, "bus")) {
+        mb_group_bus(&m);
+    }
+    if (group_selected(argc, argv, "op")) {
+        mb_group_ops(&m, false);
+    }
+    if (group_selected(argc, argv, "cb")) {
+        mb_group_ops(&m, true);
+    }
+    if (group_selected(argc, argv, "ppu")) {
+        mb_group_ppu(&m);
+    }
+    if (group_selected(argc, argv, "mix")) {
+        mb_group_mix();
+    }
+    tool_machine_free(&m);
+    tool_cart_free(cart);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,391 @@
+// Scripted game benchmark: boots a ROM, plays an input movie through it
+// and reports throughput per phase of the movie, so a change can be seen
+// in the title screen, text boxes, overworld scrolling or menus rather
+// than only in one average. The movie also carries frame hashes; every
+// trial must reproduce them, which pins the workload down to the same
+// instructions on every run and every build.
+//
+//   bin/easygb_scenario [--trials N] [--record OUT] ROM MOVIE
+//
+// --record plays the movie once and writes it to OUT with the check lines
+// filled in from this build, for writing a new movie or after a change
+// that alters the picture on purpose.
+//
+// Movie format, one step per line ('#' starts a comment):
+//
+//   phase NAME        following steps are timed as NAME
+//   FRAMES BUTTONS    hold BUTTONS for FRAMES frames; BUTTONS is '-' or
+//                     names from A B SELECT START UP DOWN LEFT RIGHT
+//                     joined with '+', e.g. "8 START" or "16 UP+B"
+//   check HASH        the last frame's FNV-1a hash must be HASH ('-' in
+//                     a movie being recorded)
+//
+// Input changes land on frame boundaries, as in the headless emulator.
+// Runs start from the post-boot state at 0100h.
+
+#include "tool_machine.h"
+#include "tool_util.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+    GB_CPU_HZ = 4194304,
+    SCENARIO_MAX_TRIALS = 100,
+    SCENARIO_MAX_PHASES = 32,
+    SCENARIO_NAME_SIZE = 32,
+    SCENARIO_LINE_SIZE = 256
+};
+
+// Exit codes: a hash mismatch is told apart from a broken invocation.
+enum scenario_exit {
+    SCENARIO_EXIT_OK = 0,
+    SCENARIO_EXIT_ERROR = 1,
+    SCENARIO_EXIT_MISMATCH = 2
+};
+
+enum step_kind {
+    STEP_PHASE,
+    STEP_INPUT,
+    STEP_CHECK
+};
+
+struct step {
+    enum step_kind kind;
+    int phase;                  // STEP_PHASE
+    uint32_t frames;            // STEP_INPUT
+    uint8_t buttons;
+    bool has_hash;              // STEP_CHECK
+    uint64_t hash;
+    int line;                   // in the movie file
+};
+
+struct movie {
+    struct step *steps;
+    size_t count;
+    size_t capacity;
+    char phases[SCENARIO_MAX_PHASES][SCENARIO_NAME_SIZE];
+    int phase_count;
+    char **lines;               // the file as read, for --record
+    size_t line_count;
+};
+
+struct phase_time {
+    double seconds;
+    uint64_t cycles;
+    uint64_t frames;
+};
+
+static const struct {
+    const char *name;
+    uint8_t mask;
+} button_names[] = {
+    {"A", JOY_A}, {"B", JOY_B}, {"SELECT", JOY_SELECT}, {"START", JOY_START},
+    {"UP", JOY_UP}, {"DOWN", JOY_DOWN}, {"LEFT", JOY_LEFT}, {"RIGHT", JOY_RIGHT}
+};
+
+static void *grow(void *ptr, size_t *capacity, size_t size) {
+    *capacity = *capacity != 0u ? *capacity * 2u : 64u;
+    void *next = realloc(ptr, *capacity * size);
+    if (next == NULL) {
+        perror("[ERROR] Failed movie allocation!");
+        exit(EXIT_FAILURE);
+    }
+    return next;
+}
+
+static bool parse_buttons(char *text, uint8_t *out) {
+    *out = 0;
+    if (strcmp(text, "-") == 0) {
+        return true;
+    }
+    for (char *name = strtok(text, "+"); name != NULL; name = strtok(NULL, "+")) {
+        bool found = false;
+        for (size_t i = 0; i < sizeof(button_names) / sizeof(button_names[0]); i++) {
+            if (strcasecmp(name, button_names[i].name) == 0) {
+                *out |= button_names[i].mask;
+                found = true;
+            }
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool parse_step(struct movie *m, char *text, int line, struct step *s) {
+    char *word = strtok(text, " \t");
+    char *arg = strtok(NULL, " \t");
+    char *extra = strtok(NULL, " \t");
+    char *end = NULL;
+
+    memset(s, 0, sizeof(*s));
+    s->line = line;
+    if (arg == NULL || extra != NULL) {
+        return false;
+    }
+    if (strcmp(word, "phase") == 0) {
+        // a name used again adds to the same phase
+        s->kind = STEP_PHASE;
+        for (s->phase = 0; s->phase < m->phase_count; s->phase++) {
+            if (strcmp(m->phases[s->phase], arg) == 0) {
+                return true;
+            }
+        }
+        if (m->phase_count >= SCENARIO_MAX_PHASES || strlen(arg) >= SCENARIO_NAME_SIZE) {
+            return false;
+        }
+        strcpy(m->phases[m->phase_count++], arg);
+        return true;
+    }
+    if (strcmp(word, "check") == 0) {
+        s->kind = STEP_CHECK;
+        if (strcmp(arg, "-") == 0) {
+            return true;
+        }
+        s->hash = strtoull(arg, &end, 16);
+        s->has_hash = end != arg && *end == '\0';
+        return s->has_hash;
+    }
+    unsigned long frames = strtoul(word, &end, 10);
+    if (end == word || *end != '\0' || frames == 0u || frames > 1000000u) {
+        return false;
+    }
+    s->kind = STEP_INPUT;
+    s->frames = (uint32_t)frames;
+    return parse_buttons(arg, &s->buttons);
+}
+
+// Returns false (after printing why) if the movie is missing or malformed.
+static bool movie_load(const char *path, struct movie *m) {
+    FILE *f = fopen(path, "r");
+    if (f == NULL) {
+        perror("[ERROR] Unable to open movie");
+        return false;
+    }
+
+    size_t line_capacity = 0;
+    char buf[SCENARIO_LINE_SIZE];
+    int line = 0;
+    memset(m, 0, sizeof(*m));
+    while (fgets(buf, sizeof(buf), f) != NULL) {
+        line++;
+        buf[strcspn(buf, "\r\n")] = '\0';
+        if (m->line_count == line_capacity) {
+            m->lines = (char **)grow(m->lines, &line_capacity, sizeof(*m->lines));
+        }
+        m->lines[m->line_count] = strdup(buf);
+        if (m->lines[m->line_count] == NULL) {
+            perror("[ERROR] Failed movie allocation!");
+            exit(EXIT_FAILURE);
+        }
+        m->line_count++;
+
+        char *text = buf;
+        text[strcspn(text, "#")] = '\0';
+        while (isspace((unsigned char)*text)) {
+            text++;
+        }
+        if (*text == '\0') {
+            continue;
+        }
+        if (m->count == m->capacity) {
+            m->steps = (struct step *)grow(m->steps, &m->capacity, sizeof(*m->steps));
+        }
+        if (!parse_step(m, text, line, &m->steps[m->count])) {
+            fprintf(stderr, "[ERROR] %s:%d: bad movie step\n", path, line);
+            fclose(f);
+            return false;
+        }
+        m->count++;
+    }
+    fclose(f);
+
+    if (m->phase_count == 0 || m->count == 0u || m->steps[0].kind != STEP_PHASE) {
+        fprintf(stderr, "[ERROR] %s: a movie starts with a phase line\n", path);
+        return false;
+    }
+    return true;
+}
+
+static void movie_free(struct movie *m) {
+    for (size_t i = 0; i < m->line_count; i++) {
+        free(m->lines[i]);
+    }
+    free(m->lines);
+    free(m->steps);
+}
+
+// Plays the movie on a fresh machine, adding each phase's emulation time
+// to times. Check steps compare against the movie, or with got != NULL
+// store the hashes seen there. Returns the number of mismatches.
+static int scenario_run(cartridge cart, const struct movie *m, struct phase_time *times,
+                        uint64_t *got) {
+    struct tool_machine mach;
+    tool_machine_init(&mach, cart, true, "null");
+    struct phase_time *phase = &times[0];
+    uint64_t frames = 0;
+    int mismatches = 0;
+
+    for (size_t i = 0; i < m->count; i++) {
+        const struct step *s = &m->steps[i];
+        if (s->kind == STEP_PHASE) {
+            phase = &times[s->phase];
+            continue;
+        }
+        if (s->kind == STEP_CHECK) {
+            uint64_t h = tool_frame_hash(mach.p);
+            if (got != NULL) {
+                got[i] = h;
+            } else if (!s->has_hash || h != s->hash) {
+                fprintf(stderr, "[WARN] Movie line %d, frame %llu: hash %016llx, expected %s%016llx\n",
+                        s->line, (unsigned long long)frames, (unsigned long long)h,
+                        s->has_hash ? "" : "none, not ", (unsigned long long)s->hash);
+                mismatches++;
+            }
+            continue;
+        }
+
+        bus_set_joypad_state(mach.b, s->buttons);
+        uint64_t start_cycle = bus_get_cycles(mach.b);
+        double start = tool_now_sec();
+        for (uint32_t f = 0; f < s->frames; f++) {
+            tool_machine_run_frame(&mach);
+        }
+        phase->seconds += tool_now_sec() - start;
+        phase->cycles += bus_get_cycles(mach.b) - start_cycle;
+        phase->frames += s->frames;
+        frames += s->frames;
+    }
+
+    tool_machine_free(&mach);
+    return mismatches;
+}
+
+static void record(cartridge cart, const struct movie *m, struct phase_time *times, FILE *out) {
+    uint64_t *got = (uint64_t *)calloc(m->count, sizeof(*got));
+    if (got == NULL) {
+        perror("[ERROR] Failed movie allocation!");
+        exit(EXIT_FAILURE);
+    }
+    scenario_run(cart, m, times, got);
+
+    size_t step = 0;
+    for (size_t i = 0; i < m->line_count; i++) {
+        while (step < m->count && m->steps[step].line < (int)i + 1) {
+            step++;
+        }
+        if (step < m->count && m->steps[step].line == (int)i + 1 &&
+            m->steps[step].kind == STEP_CHECK) {
+            // swap the hash in place, keeping indentation and any comment
+            const char *text = m->lines[i];
+            size_t head = strspn(text, " \t");
+            head += strcspn(&text[head], " \t");
+            head += strspn(&text[head], " \t");
+            const char *rest = &text[head] + strcspn(&text[head], " \t#");
+            fprintf(out, "%.*s%016llx%s\n", (int)head, text, (unsigned long long)got[step], rest);
+        } else {
+            fprintf(out, "%s\n", m->lines[i]);
+        }
+    }
+    free(got);
+}
+
+static double median(double *v, int n) {
+    qsort(v, (size_t)n, sizeof(v[0]), tool_compare_double);
+    return n % 2 != 0 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+static void print_phase(const char *name, const struct phase_time *t, double seconds) {
+    printf("  %-12s %6llu frames %9.1f frames/s %8.2f MHz %6.1fx real time\n", name,
+           (unsigned long long)t->frames, seconds > 0.0 ? (double)t->frames / seconds : 0.0,
+           seconds > 0.0 ? (double)t->cycles / seconds / 1e6 : 0.0,
+           seconds > 0.0 ? (double)t->cycles / seconds / GB_CPU_HZ : 0.0);
+}
+
+int main(int argc, char **argv) {
+    int trials = 3;
+    const char *record_path = NULL;
+    int arg = 1;
+
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--record") == 0 && arg + 1 < argc) {
+            record_path = argv[++arg];
+        } else if (strcmp(argv[arg], "--trials") == 0 && arg + 1 < argc) {
+            char *end = NULL;
+            long v = strtol(argv[++arg], &end, 10);
+            if (end == argv[arg] || *end != '\0' || v < 1 || v > SCENARIO_MAX_TRIALS) {
+                fprintf(stderr, "--trials must be 1-%d\n", SCENARIO_MAX_TRIALS);
+                return SCENARIO_EXIT_ERROR;
+            }
+            trials = (int)v;
+        } else {
+            fprintf(stderr, "Unknown option %s\n", argv[arg]);
+            return SCENARIO_EXIT_ERROR;
+        }
+    }
+    if (argc - arg != 2) {
+        fprintf(stderr, "Usage: %s [--trials N] [--record OUT] ROM MOVIE\n", argv[0]);
+        return SCENARIO_EXIT_ERROR;
+    }
+
+    struct movie m;
+    if (!movie_load(argv[arg + 1], &m)) {
+        movie_free(&m);
+        return SCENARIO_EXIT_ERROR;
+    }
+    cartridge cart = tool_cart_load(argv[arg]);
+    if (cart == NULL) {
+        movie_free(&m);
+        return SCENARIO_EXIT_ERROR;
+    }
+    struct phase_time times[SCENARIO_MAX_TRIALS][SCENARIO_MAX_PHASES];
+    memset(times, 0, sizeof(times));
+    int status = SCENARIO_EXIT_OK;
+
+    if (record_path != NULL) {
+        FILE *out = fopen(record_path, "w");
+        if (out == NULL) {
+            perror("[ERROR] Unable to write movie");
+            status = SCENARIO_EXIT_ERROR;
+        } else {
+            record(cart, &m, times[0], out);
+            fclose(out);
+            printf("Movie with this build's frame hashes written to %s\n", record_path);
+        }
+    } else {
+        int mismatches = 0;
+        for (int t = 0; t < trials; t++) {
+            mismatches += scenario_run(cart, &m, times[t], NULL);
+        }
+
+        printf("%s with %s, median of %d trials\n", argv[arg], argv[arg + 1], trials);
+        struct phase_time total = {0};
+        double total_s[SCENARIO_MAX_TRIALS];
+        memset(total_s, 0, sizeof(total_s));
+        for (int ph = 0; ph < m.phase_count; ph++) {
+            double s[SCENARIO_MAX_TRIALS];
+            for (int t = 0; t < trials; t++) {
+                s[t] = times[t][ph].seconds;
+                total_s[t] += s[t];
+            }
+            print_phase(m.phases[ph], &times[0][ph], median(s, trials));
+            total.cycles += times[0][ph].cycles;
+            total.frames += times[0][ph].frames;
+        }
+        print_phase("total", &total, median(total_s, trials));
+
+        if (mismatches != 0) {
+            printf("[WARN] %d frame hash checks failed: the workload differs from the movie's\n",
+                   mismatches);
+            status = SCENARIO_EXIT_MISMATCH;
+        }
+    }
+
+    movie_free(&m);
+    tool_cart_free(cart);
+    return status;
+}
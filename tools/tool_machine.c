@@ -0,0 +1,69 @@
+#include "tool_machine.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+cartridge tool_cart_load(const char *path) {
+    FILE *probe = fopen(path, "rb");
+    if (probe == NULL) {
+        perror("[ERROR] Unable to open ROM");
+        return NULL;
+    }
+    fclose(probe);
+    return read_cart(path);
+}
+
+void tool_cart_free(cartridge cart) {
+    if (cart == NULL) {
+        return;
+    }
+    free(cart->raw_cart);
+    free(cart->head);
+    free(cart);
+}
+
+void tool_machine_init(struct tool_machine *m, cartridge cart, bool post_boot,
+                       const char *sink_spec) {
+    memset(m, 0, sizeof(*m));
+    m->b = post_boot ? bus_init_post_boot(cart) : bus_init(cart);
+    m->c = cpu_init(m->b);
+    m->p = ppu_init(m->b);
+    m->a = apu_init_with_spec(m->b, sink_spec);
+}
+
+void tool_machine_free(struct tool_machine *m) {
+    apu_destroy(m->a);
+    ppu_destroy(m->p);
+    free(m->c);
+    bus_destroy(m->b);
+    memset(m, 0, sizeof(*m));
+}
+
+int tool_machine_run_frame(struct tool_machine *m) {
+    int frame_cycles = 0;
+    while (frame_cycles < TOOL_FRAME_CYCLES) {
+        frame_cycles += cpu_step(m->c);
+        if (m->ppu_eager) {
+            ppu_sync(m->p);
+        }
+        if (m->p->frame_ready) {
+            m->p->frame_ready = false;
+            apu_end_frame(m->a);
+            return frame_cycles;
+        }
+    }
+    ppu_sync(m->p);
+    apu_end_frame(m->a);
+    return frame_cycles;
+}
+
+uint64_t tool_frame_hash(ppu p) {
+    const uint8_t *px = &p->framebuffer[0][0];
+    uint64_t h = 1469598103934665603ull;
+    for (size_t i = 0; i < sizeof(p->framebuffer); i++) {
+        h ^= px[i];
+        h *= 1099511628211ull;
+    }
+    return h;
+}
@@ -0,0 +1,42 @@
+#ifndef TOOL_MACHINE_H
+#define TOOL_MACHINE_H
+
+// A whole machine for the tools that run ROMs headless (bench, microbench,
+// scenario, ppu_check): setup, the headless frame loop and teardown.
+
+#include "../src/include/apu.h"
+#include "../src/include/bus.h"
+#include "../src/include/cpu.h"
+#include "../src/include/ppu.h"
+
+enum {
+    TOOL_FRAME_CYCLES = 70224
+};
+
+struct tool_machine {
+    bus b;
+    cpu c;
+    ppu p;
+    apu a;
+    bool ppu_eager;             // ppu_sync after every instruction (ppu_check)
+};
+
+// Loads the ROM at path, or prints why and returns NULL.
+cartridge tool_cart_load(const char *path);
+void tool_cart_free(cartridge cart);
+
+// A fresh machine on cart, from the post-boot state at 0100h or from the
+// boot ROM, with audio going to an apu_sink_open spec.
+void tool_machine_init(struct tool_machine *m, cartridge cart, bool post_boot,
+                       const char *sink_spec);
+void tool_machine_free(struct tool_machine *m);
+
+// One pass of the headless loop's run_frame: runs until the PPU finishes a
+// frame or for a frame's worth of cycles, leaves the PPU synced, and
+// closes the audio frame. Returns the cycles run.
+int tool_machine_run_frame(struct tool_machine *m);
+
+// FNV-1a over the shade framebuffer.
+uint64_t tool_frame_hash(ppu p);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef TOOL_UTIL_H
+#define TOOL_UTIL_H
+
+// Timing and sorting shared by the benchmark and check tools. Header-only,
+// so tools that link no emulator core (audio_bench) can use it too.
+
+#include <stdint.h>
+#include <time.h>
+
+static inline double tool_now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static inline uint64_t tool_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// qsort comparator, ascending.
+static inline int tool_compare_double(const void *x, const void *y) {
+    double a = *(const double *)x;
+    double b = *(const double *)y;
+    return (a > b) - (a < b);
+}
+
+#endif